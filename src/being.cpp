@@ -42,6 +42,7 @@
 #include "map.h"
 
 #include "graphics/animation.h"
+#include "graphics/avatarcache.h"
 #include "graphics/graphics.h"
 #include "graphics/texture.h"
 
@@ -107,6 +108,7 @@ namespace ST
         look.skinColour.b = 0;
 
         mAnchor = 16;
+        mPartCount = 0;
         mNPC = false;
         mTileChanged = false;
     }
@@ -155,6 +157,7 @@ namespace ST
         // delete any old animation that was set
         delete mSetAnimation;
         mSetAnimation = NULL;
+        mPartCount = 0;
 
         // if name is empty, unset the animation
         if (name.empty())
@@ -183,38 +186,89 @@ namespace ST
         unsigned int frames = body->getFrames();
         frames = std::min(frames, hair->getFrames());
 
-        // create new frames and store them in the animation
+        if (graphicsEngine->drawLayeredAvatars())
+        {
+            // the parts are drawn over each other, so nothing is composed,
+            // the body's frames give the animation its size and timing
+            mParts[mPartCount++] = body;
+            mParts[mPartCount++] = hair;
+            if (legs)
+                mParts[mPartCount++] = legs;
+            if (chest)
+                mParts[mPartCount++] = chest;
+            if (feet)
+                mParts[mPartCount++] = feet;
+
+            for (unsigned int i = 0; i < frames; ++i)
+                mSetAnimation->addTexture(body->getTexture(i));
+
+            mUpdateTime = 1000 / mSetAnimation->getFrames();
+            return;
+        }
+
+        // beings that look the same share frames
+        AvatarKey key;
+        key.body = look.body;
+        key.hair = look.hair;
+        key.chest = look.chest;
+        key.legs = look.legs;
+        key.feet = look.feet;
+        key.animation = name;
+        key.direction = mDirection;
+
+        // get the frames from the cache, its only composed when not there
         for (unsigned int i = 0; i < frames; ++i)
         {
             std::map<int, Texture*> textures;
-            textures[PART_BODY] = body->getTexture();
-            textures[PART_HAIR] = hair->getTexture();
+            textures[PART_BODY] = body->getTexture(i);
+            textures[PART_HAIR] = hair->getTexture(i);
             if (chest)
-                textures[PART_CHEST] = chest->getTexture();
+                textures[PART_CHEST] = chest->getTexture(i);
             if (legs)
-                textures[PART_LEGS] = legs->getTexture();
+                textures[PART_LEGS] = legs->getTexture(i);
             if (feet)
-                textures[PART_FEET] = feet->getTexture();
-            Texture *tex = graphicsEngine->createAvatarFrame(mId, i+1, textures, mDirection);
-            mSetAnimation->addTexture(tex);
-            body->nextFrame();
-            hair->nextFrame();
-            if (chest)
-                chest->nextFrame();
-            if (legs)
-                legs->nextFrame();
-            if (feet)
-                feet->nextFrame();
+                textures[PART_FEET] = feet->getTexture(i);
+
+            key.frame = i;
+            mSetAnimation->addTexture(graphicsEngine->getAvatarFrame(key, textures));
         }
 
         // set the update rate based on number of frames per second
         mUpdateTime = 1000 / mSetAnimation->getFrames();
     }
 
+    unsigned int Being::getTextureLayers(Texture **textures, unsigned int max)
+    {
+        if (!graphicsEngine->drawLayeredAvatars())
+            return 0;
+
+        unsigned int count = 0;
+        if (mSetAnimation && mPartCount)
+        {
+            unsigned int frame = mSetAnimation->getCurrentFrame();
+            for (unsigned int i = 0; i < mPartCount && count < max; ++i)
+            {
+                Texture *texture = mParts[i]->getTexture(frame);
+                if (texture)
+                    textures[count++] = texture;
+            }
+            return count;
+        }
+
+        // without an animation the parts face the same way as createAvatar
+        int parts[MAX_PARTS] = { look.body, look.hair, look.legs, look.chest, look.feet };
+        for (unsigned int i = 0; i < MAX_PARTS && count < max; ++i)
+        {
+            BodyPart *part = resourceManager->getBodyPart(parts[i]);
+            if (part && part->getTexture(DIRECTION_SOUTHEAST))
+                textures[count++] = part->getTexture(DIRECTION_SOUTHEAST);
+        }
+
+        return count;
+    }
+
     bool Being::calculateNextDestination(const Point &finish)
     {
-        int hops = 0;
-        int dir = DIRECTION_NORTH;
         int hw = mWidth >> 1;
         int mapHeight = mapEngine->getTileHeight();
         int hmh = mapHeight >> 1;
@@ -226,33 +280,25 @@ namespace ST
         // empty any previous path
         mWaypoints.clear();
 
-        Point wayPos = getTilePosition();
-        Point endPos = finish;
-        Point screenPos = {0,0};
-
-        // keep moving a tile towards destination until reached
-        while(hops < 20)
+        std::vector<Point> path;
+        if (!mapEngine->findPath(getTilePosition(), finish, path))
         {
-            if (wayPos.x == endPos.x && wayPos.y == endPos.y)
-            {
-                break;
-            }
+            return false;
+        }
 
-            // find a direction to move closer to the end point
-            dir = getDirection(wayPos, endPos);
-            // find the tile inbetween
-            wayPos = getNextTile(wayPos, dir);
+        Point screenPos = {0,0};
 
+        for (unsigned int i = 0; i < path.size(); ++i)
+        {
             // translate to screen position and store that
-            screenPos = mapEngine->convertTileToPixel(wayPos);
+            screenPos = mapEngine->convertTileToPixel(path[i]);
             screenPos.x += hw >> 1;
             screenPos.y += hmh;
 
             mWaypoints.push_back(screenPos);
-            ++hops;
         }
 
-        return (hops < 20);
+        return true;
     }
 
     bool Being::calculateNextDestination()
@@ -304,8 +350,7 @@ namespace ST
         distance = distx * distx + disty * disty;
         if (distance < 1 && distance > -1)
         {
-            mPosition.x = mWaypoints[0].x;
-            mPosition.y = mWaypoints[0].y;
+            moveNode(&mWaypoints[0]);
             return;
         }
         distance = sqrtf(distance);
@@ -328,7 +373,6 @@ namespace ST
         if (srcTile.x != destTile.x || srcTile.y != destTile.y)
         {
             mTileChanged = true;
-            graphicsEngine->sort();
         }
         else
         {
@@ -353,33 +397,6 @@ namespace ST
         mLastPosition = nextPos;
     }
 
-    Point Being::getNextTile(const Point &pt, int dir)
-    {
-        Point pos = mapEngine->walkMap(pt, dir);
-        int attempts = 2;
-        int diff = 1;
-
-        // keep trying a different direction till valid tile found
-        // or until maximum number of attempts failed
-        while (attempts > 0 && mapEngine->blocked(pos))
-        {
-            dir += diff;
-            pos = mapEngine->walkMap(pt, dir);
-            // count down so it doesnt loop forever
-            --attempts;
-            // make it try different direction next time
-            diff = -diff;
-
-            // check for greater or less than minimum and maximum direction
-            if (dir < DIRECTION_NORTH)
-                dir = DIRECTION_NORTHWEST;
-            if (dir > DIRECTION_NORTHWEST)
-                dir = DIRECTION_NORTH;
-        }
-
-        return pos;
-    }
-
     void Being::saveDestination(const Point &pos)
     {
         mDestination = pos;
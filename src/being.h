@@ -92,6 +92,12 @@ namespace ST
         /** Set the animation */
         virtual void setAnimation(const std::string &name);
 
+        /**
+         * With layered avatars the body parts are drawn over
+         * each other, rather than as one composed texture
+         */
+        virtual unsigned int getTextureLayers(Texture **textures, unsigned int max);
+
         /**
          * Logic called each frame
          * @param ms Number of milliseconds since last frame
@@ -144,8 +150,6 @@ namespace ST
     protected:
         void move(int ms);
 
-        Point getNextTile(const Point &pt, int dir);
-
     protected:
         unsigned int mId;
         int mState;
@@ -155,6 +159,11 @@ namespace ST
         bool mTileChanged;
         bool mNPC;
         bool mTalking;
+
+        // animations of each body part, in the order they are drawn
+        enum { MAX_PARTS = 5 };
+        Animation *mParts[MAX_PARTS];
+        unsigned int mPartCount;
     };
 }
 
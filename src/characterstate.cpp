@@ -306,13 +306,15 @@ namespace ST
                     AG_Surface *surface = NULL;
                     if (graphicsEngine->isOpenGL())
                     {
+						// the texture may still be being made on the render thread
+						graphicsEngine->finishFrame();
 						pixmap = AG_PixmapFromTexture(0, 0, tex->getGLTexture(), 0);
                     }
                     else
                     {
                         SDL_Surface *s = tex->getSDLSurface();
                         SDL_LockSurface(s);
-                        surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
+                        surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, s->format->Rmask, s->format->Gmask, s->format->Bmask, s->format->Amask);
                         SDL_UnlockSurface(s);
                         pixmap = AG_PixmapFromSurface(0, 0, surface);
                     }
@@ -407,7 +409,7 @@ namespace ST
             SDL_Surface *s = NULL;
             if (graphicsEngine->isOpenGL())
             {
-                s = graphicsEngine->createSurface(tex->getGLTexture(), resourceManager->getBodyWidth(), resourceManager->getBodyHeight());
+                s = graphicsEngine->createSurface(tex, resourceManager->getBodyWidth(), resourceManager->getBodyHeight());
                 if (s)
                 {
                     SDL_LockSurface(s);
@@ -426,7 +428,7 @@ namespace ST
                 if (s)
                 {
                     SDL_LockSurface(s);
-                    surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
+                    surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, s->format->Rmask, s->format->Gmask, s->format->Bmask, s->format->Amask);
                     SDL_UnlockSurface(s);
                 }
                 if (surface)
@@ -448,7 +450,7 @@ namespace ST
         SDL_Surface *s = NULL;
         if (graphicsEngine->isOpenGL())
         {
-            s = graphicsEngine->createSurface(tex->getGLTexture(), resourceManager->getBodyWidth(), resourceManager->getBodyHeight());
+            s = graphicsEngine->createSurface(tex, resourceManager->getBodyWidth(), resourceManager->getBodyHeight());
             SDL_LockSurface(s);
             surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
             SDL_UnlockSurface(s);
@@ -457,7 +459,7 @@ namespace ST
         {
             s = tex->getSDLSurface();
             SDL_LockSurface(s);
-            surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
+            surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, s->format->Rmask, s->format->Gmask, s->format->Bmask, s->format->Amask);
             SDL_UnlockSurface(s);
         }
 
@@ -497,7 +499,7 @@ namespace ST
             AG_Surface *surface = NULL;
             if (graphicsEngine->isOpenGL())
             {
-                s = graphicsEngine->createSurface(tex->getGLTexture(), tex->getWidth(), tex->getHeight());
+                s = graphicsEngine->createSurface(tex, tex->getWidth(), tex->getHeight());
                 SDL_LockSurface(s);
                 surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
                 SDL_UnlockSurface(s);
@@ -506,7 +508,7 @@ namespace ST
             {
                 s = tex->getSDLSurface();
                 SDL_LockSurface(s);
-                surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
+                surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, s->format->Rmask, s->format->Gmask, s->format->Bmask, s->format->Amask);
                 SDL_UnlockSurface(s);
             }
             AG_ButtonSurface(button, surface);
@@ -0,0 +1,215 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "collisionmap.h"
+
+#include <algorithm>
+
+namespace ST
+{
+    // number of bits set in a word
+    static unsigned int countBits(CollisionMap::Word word)
+    {
+        unsigned int count = 0;
+        while (word)
+        {
+            word &= word - 1;
+            ++count;
+        }
+        return count;
+    }
+
+	CollisionMap::CollisionMap() :
+        mWidth(0),
+        mHeight(0),
+        mWordsPerRow(0),
+        mVersion(0)
+	{
+
+	}
+
+	void CollisionMap::create(unsigned int width, unsigned int height)
+	{
+        mWidth = width;
+        mHeight = height;
+
+        // one extra word on each row, filled with blocked tiles,
+        // so reading past the end of the map needs no special case
+        mWordsPerRow = ((width + WORD_BITS - 1) / WORD_BITS) + 1;
+        mBits.assign(mWordsPerRow * height, 0);
+
+        for (unsigned int y = 0; y < height; ++y)
+        {
+            Word *row = &mBits[y * mWordsPerRow];
+            for (unsigned int i = width / WORD_BITS; i < mWordsPerRow; ++i)
+            {
+                row[i] = ~(Word)0;
+            }
+            if (width % WORD_BITS)
+            {
+                row[width / WORD_BITS] = ~(Word)0 << (width % WORD_BITS);
+            }
+        }
+
+        ++mVersion;
+	}
+
+	void CollisionMap::clear()
+	{
+        mBits.clear();
+        mWidth = 0;
+        mHeight = 0;
+        mWordsPerRow = 0;
+        ++mVersion;
+	}
+
+	void CollisionMap::setBlocked(int x, int y, bool blocked)
+	{
+        if ((unsigned int)x >= mWidth || (unsigned int)y >= mHeight)
+            return;
+
+        Word bit = (Word)1 << (x & 63);
+        Word &word = mBits[y * mWordsPerRow + (x >> 6)];
+
+        if (blocked)
+            word |= bit;
+        else
+            word &= ~bit;
+
+        ++mVersion;
+	}
+
+	CollisionMap::Word CollisionMap::getRow(int x, int y) const
+	{
+        if ((unsigned int)y >= mHeight || x >= (int)mWidth || x <= -WORD_BITS)
+            return ~(Word)0;
+
+        // shift in blocked tiles for the part left of the map
+        if (x < 0)
+        {
+            int missing = -x;
+            return (getRow(0, y) << missing) | (((Word)1 << missing) - 1);
+        }
+
+        const Word *row = &mBits[y * mWordsPerRow];
+        int word = x >> 6;
+        int shift = x & 63;
+
+        Word mask = row[word] >> shift;
+        if (shift)
+            mask |= row[word + 1] << (WORD_BITS - shift);
+
+        return mask;
+	}
+
+	CollisionMap::Word CollisionMap::rowMask(int x1, int x2, int y, int word) const
+	{
+        // bits of the word that are between x1 and x2
+        int first = word * WORD_BITS;
+        Word mask = ~(Word)0;
+
+        if (x1 > first)
+            mask &= ~(Word)0 << (x1 - first);
+        if (x2 < first + WORD_BITS - 1)
+            mask &= ~(Word)0 >> (first + WORD_BITS - 1 - x2);
+
+        return mBits[y * mWordsPerRow + word] & mask;
+	}
+
+	bool CollisionMap::rowBlocked(int x1, int x2, int y) const
+	{
+        if (x1 > x2)
+            return false;
+
+        if (x1 < 0 || x2 >= (int)mWidth || (unsigned int)y >= mHeight)
+            return true;
+
+        for (int word = x1 >> 6; word <= (x2 >> 6); ++word)
+        {
+            if (rowMask(x1, x2, y, word))
+                return true;
+        }
+
+        return false;
+	}
+
+	bool CollisionMap::areaBlocked(const Rectangle &area) const
+	{
+        int x2 = area.x + area.width - 1;
+        int y2 = area.y + area.height - 1;
+
+        for (int y = area.y; y <= y2; ++y)
+        {
+            if (rowBlocked(area.x, x2, y))
+                return true;
+        }
+
+        return false;
+	}
+
+	unsigned int CollisionMap::countBlocked(const Rectangle &area) const
+	{
+        unsigned int count = 0;
+        int x2 = area.x + area.width - 1;
+        int y2 = area.y + area.height - 1;
+
+        for (int y = area.y; y <= y2; ++y)
+        {
+            for (int x = area.x; x <= x2; )
+            {
+                // tiles outside the map all count as blocking
+                if (x < 0 || x >= (int)mWidth || (unsigned int)y >= mHeight)
+                {
+                    ++count;
+                    ++x;
+                    continue;
+                }
+
+                int last = std::min(x2, (int)mWidth - 1);
+                int word = x >> 6;
+                count += countBits(rowMask(x, last, y, word));
+                x = (word + 1) * WORD_BITS;
+                if (x > last)
+                    x = last + 1;
+            }
+        }
+
+        return count;
+	}
+}
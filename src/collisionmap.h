@@ -0,0 +1,158 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The CollisionMap class stores which tiles block movement,
+ * packed one bit per tile so rows can be tested 64 tiles at a time
+ */
+
+#ifndef ST_COLLISIONMAP_HEADER
+#define ST_COLLISIONMAP_HEADER
+
+#include <vector>
+
+#include "utilities/types.h"
+
+namespace ST
+{
+	class CollisionMap
+	{
+	public:
+	    typedef unsigned long long Word;
+	    enum { WORD_BITS = 64 };
+
+	public:
+		CollisionMap();
+
+		/**
+		 * Create
+		 * Sets the size of the map, all tiles start unblocked
+		 * @param width The width of the map in tiles
+		 * @param height The height of the map in tiles
+		 */
+        void create(unsigned int width, unsigned int height);
+
+        /**
+         * Clear
+         * Removes all the collision data
+         */
+        void clear();
+
+        /**
+         * Set Blocked
+         * @param x The tile x position
+         * @param y The tile y position
+         * @param blocked Whether the tile blocks
+         */
+        void setBlocked(int x, int y, bool blocked);
+
+        /**
+         * Blocked
+         * Tiles outside the map are always blocked
+         * @return Returns whether the tile blocks
+         */
+        bool blocked(int x, int y) const
+        {
+            if ((unsigned int)x >= mWidth || (unsigned int)y >= mHeight)
+                return true;
+            return (mBits[y * mWordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+        }
+
+        /**
+         * Get Row
+         * Returns 64 tiles of a row as a bit mask
+         * @param x The first tile to return, this is bit 0
+         * @param y The row
+         * @return Returns the mask, tiles outside the map are set
+         */
+        Word getRow(int x, int y) const;
+
+        /**
+         * Row Blocked
+         * @param x1 The first tile of the row to check
+         * @param x2 The last tile of the row to check
+         * @param y The row
+         * @return Returns whether any tile between x1 and x2 blocks
+         */
+        bool rowBlocked(int x1, int x2, int y) const;
+
+        /**
+         * Area Blocked
+         * @param area The tiles to check, width and height are in tiles
+         * @return Returns whether any tile inside the area blocks
+         */
+        bool areaBlocked(const Rectangle &area) const;
+
+        /**
+         * Count Blocked
+         * @param area The tiles to check, width and height are in tiles
+         * @return Returns the number of blocking tiles inside the area
+         */
+        unsigned int countBlocked(const Rectangle &area) const;
+
+        /**
+         * Get Width
+         */
+        unsigned int getWidth() const { return mWidth; }
+
+        /**
+         * Get Height
+         */
+        unsigned int getHeight() const { return mHeight; }
+
+        /**
+         * Get Version
+         * Changes every time the collision data changes,
+         * used to know when anything built from it is out of date
+         */
+        unsigned int getVersion() const { return mVersion; }
+
+	private:
+        Word rowMask(int x1, int x2, int y, int word) const;
+
+	private:
+        std::vector<Word> mBits;
+        unsigned int mWidth;
+        unsigned int mHeight;
+        unsigned int mWordsPerRow;
+        unsigned int mVersion;
+	};
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "flowfield.h"
+#include "collisionmap.h"
+#include "pathfinder.h"
+
+#include <algorithm>
+
+#include <SDL.h>
+
+namespace ST
+{
+    // a tile waiting to have its neighbours updated
+    struct FlowEntry
+    {
+        unsigned int distance;
+        int index;
+
+        // reversed so the heap returns the closest first
+        bool operator<(const FlowEntry &other) const
+        {
+            return distance > other.distance;
+        }
+    };
+
+	FlowField::FlowField(const CollisionMap &map, const Point &end) :
+        mMap(map),
+        mEnd(end),
+        mWidth(map.getWidth()),
+        mHeight(map.getHeight())
+	{
+        mDistance.resize(mWidth * mHeight, UNREACHABLE);
+
+        std::vector<FlowEntry> open;
+        FlowEntry entry;
+        entry.distance = 0;
+        entry.index = end.y * mWidth + end.x;
+        mDistance[entry.index] = 0;
+        open.push_back(entry);
+
+        // search outwards from the destination, moving between tiles costs
+        // the same both ways so these are the distances to get there
+        while (!open.empty())
+        {
+            std::pop_heap(open.begin(), open.end());
+            FlowEntry current = open.back();
+            open.pop_back();
+
+            if (current.distance != mDistance[current.index])
+                continue;
+
+            int x = current.index % mWidth;
+            int y = current.index / mWidth;
+
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if ((dx == 0 && dy == 0) || mMap.blocked(x + dx, y + dy))
+                        continue;
+
+                    unsigned int cost = Pathfinder::STRAIGHT_COST;
+                    if (dx != 0 && dy != 0)
+                    {
+                        // dont cut corners
+                        if (mMap.blocked(x + dx, y) || mMap.blocked(x, y + dy))
+                            continue;
+                        cost = Pathfinder::DIAGONAL_COST;
+                    }
+
+                    FlowEntry next;
+                    next.distance = current.distance + cost;
+                    next.index = (y + dy) * mWidth + x + dx;
+                    if (next.distance >= mDistance[next.index])
+                        continue;
+
+                    mDistance[next.index] = next.distance;
+                    open.push_back(next);
+                    std::push_heap(open.begin(), open.end());
+                }
+            }
+        }
+	}
+
+	bool FlowField::getNextStep(const Point &pos, Point &next) const
+	{
+        unsigned int best = UNREACHABLE;
+
+        // the start tile isnt checked, a being could be standing there
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                int x = pos.x + dx;
+                int y = pos.y + dy;
+                if ((dx == 0 && dy == 0) || mMap.blocked(x, y))
+                    continue;
+
+                unsigned int cost = Pathfinder::STRAIGHT_COST;
+                if (dx != 0 && dy != 0)
+                {
+                    if (mMap.blocked(x, pos.y) || mMap.blocked(pos.x, y))
+                        continue;
+                    cost = Pathfinder::DIAGONAL_COST;
+                }
+
+                unsigned int distance = mDistance[y * mWidth + x];
+                if (distance == UNREACHABLE || distance + cost >= best)
+                    continue;
+
+                best = distance + cost;
+                next.x = x;
+                next.y = y;
+            }
+        }
+
+        return best != UNREACHABLE;
+	}
+
+	bool FlowField::getPath(const Point &start, std::vector<Point> &path) const
+	{
+        path.clear();
+
+        if (start.x < 0 || start.y < 0 || start.x >= mWidth || start.y >= mHeight)
+            return false;
+
+        // each step gets closer, so this always reaches the end
+        Point pos = start;
+        Point next;
+        while (pos.x != mEnd.x || pos.y != mEnd.y)
+        {
+            if (!getNextStep(pos, next))
+            {
+                path.clear();
+                return false;
+            }
+            path.push_back(next);
+            pos = next;
+        }
+
+        return true;
+	}
+
+	FlowFieldCache::FlowFieldCache() :
+        mMap(NULL),
+        mVersion(0),
+        mTime(0)
+	{
+
+	}
+
+	FlowFieldCache::~FlowFieldCache()
+	{
+        clear();
+	}
+
+	const FlowField* FlowFieldCache::getField(const CollisionMap &map, const Point &start,
+                                              const Point &end)
+	{
+        // anything built from old collision data could go through walls
+        if (mMap != &map || mVersion != map.getVersion())
+        {
+            clear();
+            mMap = &map;
+            mVersion = map.getVersion();
+        }
+
+        if (map.blocked(end.x, end.y))
+            return NULL;
+
+        ++mTime;
+
+        for (unsigned int i = 0; i < mFields.size(); ++i)
+        {
+            const Point &pt = mFields[i].field->getDestination();
+            if (pt.x == end.x && pt.y == end.y)
+            {
+                mFields[i].lastUsed = mTime;
+                return mFields[i].field;
+            }
+        }
+
+        // one being asking over and over doesnt make a destination popular,
+        // only several beings heading there around the same time
+        unsigned int now = SDL_GetTicks();
+        int destination = end.y * map.getWidth() + end.x;
+        std::map<int, Request>::iterator itr = mRequests.find(destination);
+        if (itr != mRequests.end() && now - itr->second.started > REQUEST_WINDOW)
+        {
+            mRequests.erase(itr);
+            itr = mRequests.end();
+        }
+
+        if (itr == mRequests.end())
+        {
+            if (mRequests.size() >= MAX_REQUESTS)
+            {
+                forgetOldRequests(now);
+                if (mRequests.size() >= MAX_REQUESTS)
+                    return NULL;
+            }
+            Request request;
+            request.started = now;
+            itr = mRequests.insert(std::make_pair(destination, request)).first;
+        }
+
+        std::vector<int> &sources = itr->second.sources;
+        int source = start.y * map.getWidth() + start.x;
+        if (std::find(sources.begin(), sources.end(), source) == sources.end())
+            sources.push_back(source);
+        if (sources.size() < POPULAR_SOURCES)
+            return NULL;
+
+        mRequests.erase(itr);
+
+        CachedField cached;
+        cached.field = new FlowField(map, end);
+        cached.lastUsed = mTime;
+
+        if (mFields.size() < MAX_FIELDS)
+        {
+            mFields.push_back(cached);
+            return cached.field;
+        }
+
+        // replace the one that hasnt been used for longest
+        unsigned int oldest = 0;
+        for (unsigned int i = 1; i < mFields.size(); ++i)
+        {
+            if (mFields[i].lastUsed < mFields[oldest].lastUsed)
+                oldest = i;
+        }
+
+        delete mFields[oldest].field;
+        mFields[oldest] = cached;
+
+        return cached.field;
+	}
+
+	void FlowFieldCache::forgetOldRequests(unsigned int now)
+	{
+        std::map<int, Request>::iterator itr = mRequests.begin();
+        while (itr != mRequests.end())
+        {
+            if (now - itr->second.started > REQUEST_WINDOW)
+                mRequests.erase(itr++);
+            else
+                ++itr;
+        }
+	}
+
+	void FlowFieldCache::clear()
+	{
+        for (unsigned int i = 0; i < mFields.size(); ++i)
+        {
+            delete mFields[i].field;
+        }
+        mFields.clear();
+        mRequests.clear();
+	}
+}
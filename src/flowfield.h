@@ -0,0 +1,168 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The FlowField class stores the distance from every tile to one
+ * destination, so any number of beings can walk there without searching
+ */
+
+#ifndef ST_FLOWFIELD_HEADER
+#define ST_FLOWFIELD_HEADER
+
+#include <map>
+#include <vector>
+
+#include "utilities/types.h"
+
+namespace ST
+{
+    class CollisionMap;
+
+	class FlowField
+	{
+	public:
+		/**
+		 * Constructor
+		 * Works out the distances to the destination, using the
+		 * same costs and corner rules as the Pathfinder
+		 * @param map The collision data to use
+		 * @param end The destination tile, must not be blocked
+		 */
+		FlowField(const CollisionMap &map, const Point &end);
+
+		/**
+		 * Get Next Step
+		 * Finds the neighbouring tile that is closest to the destination
+		 * @param pos The tile to step from, it may be blocked
+		 * @param next Set to the tile to step on
+		 * @return Returns false if the destination cant be reached from pos
+		 */
+        bool getNextStep(const Point &pos, Point &next) const;
+
+        /**
+         * Get Path
+         * Follows the field from start to the destination
+         * @param start The tile to start from
+         * @param path Filled with every tile stepped on, not including start
+         * @return Returns whether the destination can be reached
+         */
+        bool getPath(const Point &start, std::vector<Point> &path) const;
+
+        /**
+         * Get Destination
+         */
+        const Point& getDestination() const { return mEnd; }
+
+	private:
+        // distance of tiles that cant reach the destination
+        enum { UNREACHABLE = 0xFFFFFFFF };
+
+        const CollisionMap &mMap;
+        std::vector<unsigned int> mDistance;
+        Point mEnd;
+        int mWidth;
+        int mHeight;
+	};
+
+	/**
+	 * The FlowFieldCache keeps flow fields for destinations that are
+	 * asked for often, such as shop doors and the town square
+	 */
+	class FlowFieldCache
+	{
+	public:
+		FlowFieldCache();
+		~FlowFieldCache();
+
+		/**
+		 * Get Field
+		 * Counts the request, and returns the field for the destination
+		 * once it has been asked for from enough different tiles in a
+		 * short time
+		 * @param map The collision data, fields are thrown away when it changes
+		 * @param start The tile the request comes from
+		 * @param end The destination tile
+		 * @return Returns the field, or NULL if the destination isnt popular yet
+		 */
+        const FlowField* getField(const CollisionMap &map, const Point &start,
+                                  const Point &end);
+
+        /**
+         * Clear
+         * Deletes all the fields and request counts
+         */
+        void clear();
+
+	private:
+        // how many different starting tiles make a destination popular
+        enum { POPULAR_SOURCES = 3 };
+        // milliseconds those requests have to arrive in
+        enum { REQUEST_WINDOW = 10000 };
+        // most destinations counted at once, new ones are ignored past this
+        enum { MAX_REQUESTS = 256 };
+        // most fields kept at once, the least recently used is replaced
+        enum { MAX_FIELDS = 8 };
+
+        struct CachedField
+        {
+            FlowField *field;
+            unsigned int lastUsed;
+        };
+
+        struct Request
+        {
+            unsigned int started; // ticks of the first request in the window
+            std::vector<int> sources; // different tiles asked from
+        };
+
+        /**
+         * Forget Old Requests
+         * Removes the requests whose window has passed
+         */
+        void forgetOldRequests(unsigned int now);
+
+        std::vector<CachedField> mFields;
+        std::map<int, Request> mRequests; // for each destination tile
+        const CollisionMap *mMap;
+        unsigned int mVersion; // of the collision data the fields were built from
+        unsigned int mTime;
+	};
+}
+
+#endif
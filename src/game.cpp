@@ -47,11 +47,13 @@
 #include "player.h"
 #include "resourcemanager.h"
 #include "graphics/graphics.h"
+#include "graphics/nullgraphics.h"
 #include "graphics/opengl.h"
 #include "graphics/sdl2d.h"
 #include "interface/interfacemanager.h"
 #include "net/networkmanager.h"
 #include "utilities/log.h"
+#include "utilities/stringutils.h"
 #include "utilities/xml.h"
 
 #include <time.h>
@@ -69,7 +71,8 @@ namespace ST
 	BeingManager *beingManager = NULL;
 	Player *player = NULL;
 
-    Game::Game(const std::string &path)
+    Game::Game(const std::string &path) : mHeadless(false),
+        mCaptureFrames(0), mReplayLoops(1)
     {
         resourceManager = new ResourceManager(path);
         logger = new Log(resourceManager->getWritablePath() + "log.txt");
@@ -93,9 +96,33 @@ namespace ST
 	void Game::restart(int opengl, int fullscreen, int x, int y)
 	{
 	    // recreate graphicsEngine
+	    bool staticCache = graphicsEngine->getStaticCache();
+	    bool dirtyRects = graphicsEngine->getDirtyRects();
+	    bool renderThread = graphicsEngine->getRenderThread();
+	    unsigned int avatarBudget = graphicsEngine->getAvatarCacheBudget();
+	    bool layeredAvatars = graphicsEngine->getLayeredAvatars();
 	    delete graphicsEngine;
 
-	    if (opengl != 0)
+	    createGraphicsEngine(opengl);
+
+	    graphicsEngine->setDirtyRects(dirtyRects);
+	    graphicsEngine->init(fullscreen, x, y);
+	    graphicsEngine->setStaticCache(staticCache);
+	    graphicsEngine->setRenderThread(renderThread);
+	    graphicsEngine->setAvatarCacheBudget(avatarBudget);
+	    graphicsEngine->setLayeredAvatars(layeredAvatars);
+	    interfaceManager->reset();
+	}
+
+	void Game::createGraphicsEngine(int opengl)
+	{
+	    if (mHeadless)
+	    {
+	        // SDL picks its video driver when the engine initialises it
+	        NullGraphics::useDummyVideo();
+	        graphicsEngine = new NullGraphics;
+	    }
+	    else if (opengl != 0)
 	    {
 	        graphicsEngine = new OpenGLGraphics;
 	    }
@@ -103,9 +130,6 @@ namespace ST
 	    {
 	        graphicsEngine = new SDLGraphics;
 	    }
-
-	    graphicsEngine->init(fullscreen, x, y);
-	    interfaceManager->reset();
 	}
 
 	void Game::run()
@@ -117,8 +141,15 @@ namespace ST
 		int opengl = 0;
 		int resx = 1024;
 		int resy = 768;
+		int staticCache = 0;
+		int dirtyRects = 0;
+		int headless = 0;
+		int renderThread = 0;
+		int avatarCache = 0;
+		int layeredAvatars = 0;
         std::string fullscreen;
         std::string lang;
+        std::string chunkRadius;
 
         if (file.load(resourceManager->getDataPath("townslife.cfg")))
         {
@@ -130,27 +161,68 @@ namespace ST
             fullscreen = file.readString("graphics", "fullscreen");
             resx = file.readInt("graphics", "width");
             resy = file.readInt("graphics", "height");
+            staticCache = file.readInt("graphics", "staticcache");
+            dirtyRects = file.readInt("graphics", "dirtyrects");
+            headless = file.readInt("graphics", "headless");
+            renderThread = file.readInt("graphics", "renderthread");
+            avatarCache = file.readInt("graphics", "avatarcache");
+            layeredAvatars = file.readInt("graphics", "layeredavatars");
             file.setElement("language");
             lang = file.readString("language", "value");
+            file.setElement("map");
+            chunkRadius = file.readString("map", "chunkradius");
         }
 
 		file.close();
 
+		// the config can ask for no display too, --headless
+		// on the command line has already set it if given
+		if (headless != 0)
+            mHeadless = true;
+
 		// check whether opengl should be used
-		opengl ? graphicsEngine = new OpenGLGraphics : graphicsEngine = new SDLGraphics;
+		createGraphicsEngine(opengl);
+
+        // only redraw what changed, the renderer picks its screen mode from this
+        graphicsEngine->setDirtyRects(dirtyRects != 0);
 
         if (fullscreen == "true")
             graphicsEngine->init(1, resx, resy);
         else
             graphicsEngine->init(0, resx, resy);
 
+        // draw the ground layers from cached chunks
+        graphicsEngine->setStaticCache(staticCache != 0);
+
+        // draw each frame while the next one is updated
+        graphicsEngine->setRenderThread(renderThread != 0);
+
+        // megabytes of composed avatar frames to keep
+        if (avatarCache > 0)
+            graphicsEngine->setAvatarCacheBudget(avatarCache * 1024 * 1024);
+
+        // draw beings as a stack of body parts with OpenGL
+        graphicsEngine->setLayeredAvatars(layeredAvatars != 0);
+
 		inputManager = new InputManager;
 		mapEngine = new Map;
+		if (!chunkRadius.empty())
+            mapEngine->setChunkRadius(utils::toInt(chunkRadius));
 		interfaceManager = new InterfaceManager;
 		networkManager = new NetworkManager;
 		beingManager = new BeingManager;
 		player = new Player;
 
+		// benchmark the renderer with a saved workload
+		if (!mReplayFile.empty())
+		{
+		    graphicsEngine->replayCapture(mReplayFile, mReplayLoops);
+		    return;
+		}
+
+		if (!mCaptureFile.empty())
+            graphicsEngine->startCapture(mCaptureFile, mCaptureFrames);
+
 		if (hostname.empty() || port == 0)
 		{
 		    logger->logWarning("Error loading configuration, using defaults");
@@ -250,4 +322,21 @@ namespace ST
     {
         return mLang;
     }
+
+    void Game::setHeadless(bool headless)
+    {
+        mHeadless = headless;
+    }
+
+    void Game::setCapture(const std::string &filename, unsigned int frames)
+    {
+        mCaptureFile = filename;
+        mCaptureFrames = frames;
+    }
+
+    void Game::setReplay(const std::string &filename, unsigned int loops)
+    {
+        mReplayFile = filename;
+        mReplayLoops = loops;
+    }
 }
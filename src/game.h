@@ -133,11 +133,47 @@ namespace ST
          */
         std::string getLanguage() const;
 
+        /**
+         * Set Headless
+         *
+         * Runs without a display, using the null renderer.
+         * Used for benchmarks and bots, takes priority over the config
+         */
+        void setHeadless(bool headless);
+
+        /**
+         * Set Capture
+         *
+         * Saves what is drawn in the first frames to a file
+         * @param filename The file to save to
+         * @param frames How many frames to save
+         */
+        void setCapture(const std::string &filename, unsigned int frames);
+
+        /**
+         * Set Replay
+         *
+         * Replays a capture instead of playing, then exits
+         * @param filename The capture to replay
+         * @param loops How many times to replay it
+         */
+        void setReplay(const std::string &filename, unsigned int loops);
+
     private:
         void cleanUp();
 
+        /**
+         * Create the renderer chosen by the options
+         */
+        void createGraphicsEngine(int opengl);
+
 	private:
 		GameState *mState;
+		bool mHeadless;
+		std::string mCaptureFile;
+		unsigned int mCaptureFrames;
+		std::string mReplayFile;
+		unsigned int mReplayLoops;
 		GameState *mOldState;
 		std::string mLang;
 	};
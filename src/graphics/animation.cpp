@@ -38,6 +38,7 @@
  ********************************************/
 
 #include "animation.h"
+#include "texture.h"
 #include <stdlib.h>
 
 namespace ST
@@ -49,11 +50,17 @@ namespace ST
 
 	Animation::~Animation()
 	{
-
+	    for (unsigned int i = 0; i < mTextures.size(); ++i)
+            mTextures[i]->remove();
 	}
 
 	void Animation::addTexture(Texture *texture)
 	{
+	    if (!texture)
+            return;
+
+	    // frames can be shared, so are held until the animation is deleted
+	    texture->increaseCount();
 		mTextures.push_back(texture);
 	}
 
@@ -62,6 +69,13 @@ namespace ST
 	    if (mTextures.empty())
             return NULL;
 	    return mTextures[mCurrFrame];
+	}
+
+	Texture* Animation::getTexture(unsigned int frame) const
+	{
+	    if (mTextures.empty())
+            return NULL;
+	    return mTextures[frame % mTextures.size()];
 	}
 
 	unsigned int Animation::getFrames()
@@ -59,10 +59,23 @@ namespace ST
 		void addTexture(Texture *texture);
 		Texture* getTexture() const;
 
+		/**
+		 * Get Texture
+		 * Returns a frame without changing the current frame,
+		 * wrapping around past the last frame
+		 */
+		Texture* getTexture(unsigned int frame) const;
+
 		unsigned int getFrames();
 
 		void nextFrame();
 
+		/**
+		 * Get Current Frame
+		 * Returns the index of the frame being shown
+		 */
+		unsigned int getCurrentFrame() const { return mCurrFrame; }
+
 	protected:
 		std::vector<Texture*> mTextures;
 		unsigned int mCurrFrame;
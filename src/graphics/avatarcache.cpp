@@ -0,0 +1,166 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "avatarcache.h"
+#include "texture.h"
+
+#include "../utilities/log.h"
+
+#include <sstream>
+
+namespace ST
+{
+	bool AvatarKey::operator<(const AvatarKey &other) const
+	{
+	    if (body != other.body)
+            return body < other.body;
+        if (hair != other.hair)
+            return hair < other.hair;
+        if (chest != other.chest)
+            return chest < other.chest;
+        if (legs != other.legs)
+            return legs < other.legs;
+        if (feet != other.feet)
+            return feet < other.feet;
+        if (direction != other.direction)
+            return direction < other.direction;
+        if (frame != other.frame)
+            return frame < other.frame;
+        return animation < other.animation;
+	}
+
+	AvatarCache::AvatarCache(unsigned int budget)
+	{
+	    mBudget = budget;
+	    mMemoryUsed = 0;
+	    mHits = 0;
+	    mMisses = 0;
+	    mEvictions = 0;
+	}
+
+	AvatarCache::~AvatarCache()
+	{
+	    logStats();
+
+	    // frames still on a being are freed when the being lets go
+	    for (FrameItr itr = mFrames.begin(); itr != mFrames.end(); ++itr)
+            itr->second.texture->remove();
+	}
+
+	Texture* AvatarCache::getFrame(const AvatarKey &key)
+	{
+	    FrameItr itr = mFrames.find(key);
+	    if (itr == mFrames.end())
+	    {
+	        ++mMisses;
+	        return NULL;
+	    }
+
+        ++mHits;
+        mUsed.splice(mUsed.begin(), mUsed, itr->second.used);
+
+        return itr->second.texture;
+	}
+
+	void AvatarCache::addFrame(const AvatarKey &key, Texture *texture)
+	{
+	    if (!texture)
+            return;
+
+        FrameItr itr = mFrames.find(key);
+        if (itr != mFrames.end())
+        {
+            // a frame replaced while a being uses it lives on until released
+            mMemoryUsed -= itr->second.size;
+            itr->second.texture->remove();
+            mUsed.erase(itr->second.used);
+            mFrames.erase(itr);
+        }
+
+        Entry entry;
+        entry.texture = texture;
+        entry.size = texture->getWidth() * texture->getHeight() * 4;
+        mUsed.push_front(key);
+        entry.used = mUsed.begin();
+        mFrames[key] = entry;
+        mMemoryUsed += entry.size;
+
+        evict();
+	}
+
+	void AvatarCache::setBudget(unsigned int budget)
+	{
+	    mBudget = budget;
+	    evict();
+	}
+
+	void AvatarCache::evict()
+	{
+	    std::list<AvatarKey>::iterator itr = mUsed.end();
+	    while (mMemoryUsed > mBudget && itr != mUsed.begin())
+	    {
+	        --itr;
+
+	        // the newest frame is kept, addFrame's caller hasnt taken it yet
+	        if (itr == mUsed.begin())
+                break;
+
+	        // only the cache holds frames that arent on a being
+	        FrameItr frame = mFrames.find(*itr);
+	        if (frame->second.texture->getCount() > 1)
+                continue;
+
+            mMemoryUsed -= frame->second.size;
+            frame->second.texture->remove();
+            mFrames.erase(frame);
+            itr = mUsed.erase(itr);
+            ++mEvictions;
+	    }
+	}
+
+	void AvatarCache::logStats()
+	{
+	    std::stringstream str;
+	    str << "Avatar cache: " << mFrames.size() << " frames using "
+            << mMemoryUsed / 1024 << "KB of " << mBudget / 1024 << "KB, "
+            << mHits << " hits, " << mMisses << " misses, "
+            << mEvictions << " evicted";
+        logger->logDebug(str.str());
+	}
+}
@@ -0,0 +1,155 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The Avatar Cache keeps the frames composed from body parts,
+ * so beings that look the same share them
+ */
+
+#ifndef ST_AVATARCACHE_HEADER
+#define ST_AVATARCACHE_HEADER
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace ST
+{
+	class Texture;
+
+	// everything that changes how a frame of an avatar looks
+	struct AvatarKey
+	{
+		int body;
+		int hair;
+		int chest;
+		int legs;
+		int feet;
+		std::string animation;
+		int direction;
+		unsigned int frame;
+
+		bool operator<(const AvatarKey &other) const;
+	};
+
+	class AvatarCache
+	{
+	public:
+		/**
+		 * Constructor
+		 * @param budget The bytes of frames to keep before evicting
+		 */
+		AvatarCache(unsigned int budget);
+
+		/**
+		 * Destructor
+		 * Releases the cache's hold on every frame
+		 */
+		~AvatarCache();
+
+		/**
+		 * Get Frame
+		 * Returns the frame and marks it as recently used
+		 * @return Returns NULL if the frame isnt cached
+		 */
+		Texture* getFrame(const AvatarKey &key);
+
+		/**
+		 * Add Frame
+		 * Keeps a new frame, the cache takes over the texture's first
+		 * reference. The least recently used frames no longer on any being
+		 * are freed until the cache fits its budget, but never the new one
+		 */
+		void addFrame(const AvatarKey &key, Texture *texture);
+
+		/**
+		 * Set Budget
+		 * Sets the bytes of frames to keep before evicting
+		 */
+		void setBudget(unsigned int budget);
+
+		/**
+		 * Get Budget
+		 * Returns the bytes of frames kept before evicting
+		 */
+		unsigned int getBudget() const { return mBudget; }
+
+		/**
+		 * Get Memory Used
+		 * Returns the bytes used by the frames cached
+		 */
+		unsigned int getMemoryUsed() const { return mMemoryUsed; }
+
+		/**
+		 * Log Stats
+		 * Writes the hits, misses and memory used to the log
+		 */
+		void logStats();
+
+	private:
+		/**
+		 * Evict
+		 * Frees frames not in use, oldest first, until within budget.
+		 * The most recently used frame is never freed
+		 */
+		void evict();
+
+	private:
+		struct Entry
+		{
+			Texture *texture;
+			unsigned int size;
+			std::list<AvatarKey>::iterator used; // position in mUsed
+		};
+
+		std::map<AvatarKey, Entry> mFrames;
+		typedef std::map<AvatarKey, Entry>::iterator FrameItr;
+
+		// most recently used first
+		std::list<AvatarKey> mUsed;
+
+		unsigned int mBudget;
+		unsigned int mMemoryUsed;
+		unsigned int mHits;
+		unsigned int mMisses;
+		unsigned int mEvictions;
+	};
+}
+
+#endif
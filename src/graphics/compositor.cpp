@@ -0,0 +1,256 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "compositor.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ST_COMPOSITE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is built in when the compiler can target it for one function,
+// and only used when the processor has it
+#if defined(__AVX2__)
+#define ST_COMPOSITE_AVX2
+#define ST_AVX2_TARGET
+#elif (defined(__x86_64__) || defined(__i386__)) && \
+      ((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) || \
+       (!defined(__clang__) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define ST_COMPOSITE_AVX2
+#define ST_COMPOSITE_AVX2_CHECK
+#define ST_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_X64) || defined(_M_IX86))
+#define ST_COMPOSITE_AVX2
+#define ST_COMPOSITE_AVX2_CHECK
+#define ST_AVX2_TARGET
+#include <intrin.h>
+#endif
+
+#ifdef ST_COMPOSITE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace ST
+{
+    /**
+     * Blend Pixel
+     * Each channel becomes d + (s - d) * a / 256, with full alpha
+     * copying the colour, which is what SDL does for alpha blits.
+     * Two channels are blended at once, 8 bits apart
+     */
+	static inline unsigned int blendPixel(unsigned int s, unsigned int d, int alphaShift)
+	{
+	    unsigned int a = (s >> alphaShift) & 0xff;
+	    unsigned int alphaMask = 0xffu << alphaShift;
+
+	    if (a == 0)
+	        return d;
+	    if (a == 255)
+	        return (s & ~alphaMask) | (d & alphaMask);
+
+	    unsigned int low = d & 0xff00ff;
+	    low = (low + (((s & 0xff00ff) - low) * a >> 8)) & 0xff00ff;
+	    unsigned int high = (d >> 8) & 0xff00ff;
+	    high = (high + ((((s >> 8) & 0xff00ff) - high) * a >> 8)) & 0xff00ff;
+
+	    return (((high << 8) | low) & ~alphaMask) | (d & alphaMask);
+	}
+
+#ifdef ST_COMPOSITE_SSE2
+    /**
+     * Blend Pixels
+     * The same as blendPixel for four pixels with alpha in the top byte
+     */
+	static inline __m128i blendPixels(__m128i s, __m128i d)
+	{
+	    const __m128i zero = _mm_setzero_si128();
+	    const __m128i full = _mm_set1_epi16(255);
+	    const __m128i total = _mm_set1_epi16(256);
+	    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+
+	    // two pixels in each half, a channel in each 16 bits
+	    __m128i sLo = _mm_unpacklo_epi8(s, zero);
+	    __m128i sHi = _mm_unpackhi_epi8(s, zero);
+	    __m128i dLo = _mm_unpacklo_epi8(d, zero);
+	    __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+	    // spread each pixel's alpha over its channels, full alpha weighs 256
+	    __m128i wLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	    __m128i wHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	    wLo = _mm_sub_epi16(wLo, _mm_cmpeq_epi16(wLo, full));
+	    wHi = _mm_sub_epi16(wHi, _mm_cmpeq_epi16(wHi, full));
+
+	    // d * (256 - w) + s * w is at most 255 * 256, so fits 16 bits
+	    __m128i rLo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(total, wLo)), _mm_mullo_epi16(sLo, wLo));
+	    __m128i rHi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(total, wHi)), _mm_mullo_epi16(sHi, wHi));
+	    __m128i result = _mm_packus_epi16(_mm_srli_epi16(rLo, 8), _mm_srli_epi16(rHi, 8));
+
+	    return _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, d));
+	}
+#endif
+
+#ifdef ST_COMPOSITE_AVX2
+    /**
+     * Has AVX2
+     * Checks the processor and the system both support AVX2
+     */
+	static bool hasAVX2()
+	{
+#if !defined(ST_COMPOSITE_AVX2_CHECK)
+	    return true;
+#elif defined(_MSC_VER)
+	    int info[4];
+	    __cpuid(info, 0);
+	    if (info[0] < 7)
+            return false;
+
+        // the system must save the AVX registers when switching threads
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+	    __builtin_cpu_init();
+	    return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	static const bool useAVX2 = hasAVX2();
+
+    /**
+     * Blend Pixels
+     * The same as blendPixel for eight pixels with alpha in the top byte
+     */
+	ST_AVX2_TARGET static inline __m256i blendPixels(__m256i s, __m256i d)
+	{
+	    const __m256i zero = _mm256_setzero_si256();
+	    const __m256i full = _mm256_set1_epi16(255);
+	    const __m256i total = _mm256_set1_epi16(256);
+	    const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+
+	    // unpacking works within each 128 bits, packing puts them back the same way
+	    __m256i sLo = _mm256_unpacklo_epi8(s, zero);
+	    __m256i sHi = _mm256_unpackhi_epi8(s, zero);
+	    __m256i dLo = _mm256_unpacklo_epi8(d, zero);
+	    __m256i dHi = _mm256_unpackhi_epi8(d, zero);
+
+	    __m256i wLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	    __m256i wHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	    wLo = _mm256_sub_epi16(wLo, _mm256_cmpeq_epi16(wLo, full));
+	    wHi = _mm256_sub_epi16(wHi, _mm256_cmpeq_epi16(wHi, full));
+
+	    __m256i rLo = _mm256_add_epi16(_mm256_mullo_epi16(dLo, _mm256_sub_epi16(total, wLo)), _mm256_mullo_epi16(sLo, wLo));
+	    __m256i rHi = _mm256_add_epi16(_mm256_mullo_epi16(dHi, _mm256_sub_epi16(total, wHi)), _mm256_mullo_epi16(sHi, wHi));
+	    __m256i result = _mm256_packus_epi16(_mm256_srli_epi16(rLo, 8), _mm256_srli_epi16(rHi, 8));
+
+	    return _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(alphaMask, d));
+	}
+
+    /**
+     * Blend Row
+     * Blends the layers over a row eight pixels at a time
+     * @return Returns how many pixels of the row were blended
+     */
+	ST_AVX2_TARGET static int blendRow(unsigned int *out, int width, int y,
+                                       const CompositeLayer *layers, int count)
+	{
+	    int x = 0;
+	    for (; x + 8 <= width; x += 8)
+	    {
+	        __m256i d = _mm256_loadu_si256((const __m256i*)(out + x));
+	        for (int i = 0; i < count; ++i)
+	        {
+	            const unsigned int *src = layers[i].pixels + y * layers[i].pitch + x;
+	            d = blendPixels(_mm256_loadu_si256((const __m256i*)src), d);
+	        }
+	        _mm256_storeu_si256((__m256i*)(out + x), d);
+	    }
+	    return x;
+	}
+#endif
+
+	void compositeLayers(unsigned int *dest, int destPitch, int width, int height,
+						 const CompositeLayer *base, const CompositeLayer *layers,
+						 int count, int alphaShift)
+	{
+	    for (int y = 0; y < height; ++y)
+	    {
+	        unsigned int *out = dest + y * destPitch;
+	        int x = 0;
+
+	        if (base)
+                memcpy(out, base->pixels + y * base->pitch, width * sizeof(unsigned int));
+            else
+                memset(out, 0, width * sizeof(unsigned int));
+
+            // the vector versions expect alpha in the top byte
+            if (alphaShift == 24)
+            {
+#ifdef ST_COMPOSITE_AVX2
+                if (useAVX2)
+                    x = blendRow(out, width, y, layers, count);
+#endif
+#ifdef ST_COMPOSITE_SSE2
+                for (; x + 4 <= width; x += 4)
+                {
+                    __m128i d = _mm_loadu_si128((const __m128i*)(out + x));
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const unsigned int *src = layers[i].pixels + y * layers[i].pitch + x;
+                        d = blendPixels(_mm_loadu_si128((const __m128i*)src), d);
+                    }
+                    _mm_storeu_si128((__m128i*)(out + x), d);
+                }
+#endif
+            }
+
+            for (; x < width; ++x)
+            {
+                unsigned int d = out[x];
+                for (int i = 0; i < count; ++i)
+                    d = blendPixel(layers[i].pixels[y * layers[i].pitch + x], d, alphaShift);
+                out[x] = d;
+            }
+	    }
+	}
+}
@@ -0,0 +1,76 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The compositor blends 32 bit layers on top of each other in one pass,
+ * using SSE2 when the compiler targets it and AVX2 when the processor has it
+ */
+
+#ifndef ST_COMPOSITOR_HEADER
+#define ST_COMPOSITOR_HEADER
+
+namespace ST
+{
+	// pixels of a layer, the pitch is in pixels not bytes
+	struct CompositeLayer
+	{
+		const unsigned int *pixels;
+		int pitch;
+	};
+
+	/**
+	 * Composite Layers
+	 * Copies the base, then blends each layer over it in order, the same
+	 * as SDL blitting a surface with per pixel alpha. The colour moves
+	 * towards the layer by its alpha and the base's alpha is kept
+	 * @param dest The pixels to write to
+	 * @param destPitch The pitch of dest in pixels
+	 * @param width The width in pixels to composite
+	 * @param height The height in pixels to composite
+	 * @param base The bottom layer, or NULL to start transparent
+	 * @param layers The layers to blend over the base, bottom first
+	 * @param count The number of layers
+	 * @param alphaShift The bit position of alpha in each pixel
+	 */
+	void compositeLayers(unsigned int *dest, int destPitch, int width, int height,
+						 const CompositeLayer *base, const CompositeLayer *layers,
+						 int count, int alphaShift);
+}
+
+#endif
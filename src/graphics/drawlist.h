@@ -0,0 +1,81 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The commands the graphics engine records for each frame
+ */
+
+#ifndef ST_DRAWLIST_HEADER
+#define ST_DRAWLIST_HEADER
+
+#include "../utilities/types.h"
+
+#include <vector>
+
+namespace ST
+{
+	class Texture;
+
+	// something to draw, recorded while the frame is updated
+	struct DrawCommand
+	{
+		enum Type
+		{
+			TEXTURE,
+			STATIC_CHUNK,
+			CLIP, // the start of a dirty part of the screen
+			RECT, // untextured, with no texture
+			FILLED_RECT
+		};
+
+		Type type;
+		Texture *texture;
+		Rectangle rect; // in screen pixels
+	};
+
+	// everything needed to draw one frame, once recorded its not changed
+	struct DrawList
+	{
+		std::vector<DrawCommand> commands;
+		std::vector<Rectangle> screenRects; // the parts of the screen to update
+		bool partial; // only the screen rects are drawn
+	};
+}
+
+#endif
@@ -39,9 +39,13 @@
 
 #include "graphics.h"
 #include "animation.h"
+#include "avatarcache.h"
 #include "camera.h"
+#include "compositor.h"
 #include "node.h"
+#include "rendercapture.h"
 #include "texture.h"
+#include "textureatlas.h"
 
 #include "../map.h"
 #include "../resourcemanager.h"
@@ -52,10 +56,12 @@
 
 #include "../utilities/log.h"
 #include "../utilities/math.h"
+#include "../utilities/threadpool.h"
 #include "../utilities/types.h"
 
 #include <SDL.h>
 #include <SDL_image.h>
+#include <algorithm>
 #include <sstream>
 #include <cassert>
 
@@ -87,12 +93,41 @@ namespace ST
 		mFrames = 0;
 		mAverageTime = 5;
 		mAverageFPS = 0;
+		mStaticCache = false;
+		mStaticLayers = 0;
+		mAtlas = NULL;
+		mDirtyRects = false;
+		mAllDirty = true;
+		mLastCameraX = 0;
+		mLastCameraY = 0;
+		mRecordList = 0;
+		mThreaded = false;
+		mRenderThread = NULL;
+		mRenderMutex = NULL;
+		mRenderCond = NULL;
+		mPendingList = NULL;
+		mQuitRender = false;
+		mRenderReady = false;
+		mRenderContext = false;
+		mJobsQueued = 0;
+		mJobsRun = 0;
+		mFramesHanded = 0;
+		mFramesDrawn = 0;
+		mCapture = NULL;
+		mAvatarCache = new AvatarCache(DEFAULT_AVATAR_BUDGET);
+		mLayeredAvatars = false;
 	}
 
 	GraphicsEngine::~GraphicsEngine()
 	{
 		if (mCamera)
 			delete mCamera;
+
+        clearStaticCache();
+
+        delete mAtlas;
+        delete mCapture;
+        delete mAvatarCache;
 
         SDL_Quit();
 
@@ -127,6 +162,7 @@ namespace ST
 	void GraphicsEngine::setCamera(Camera *cam)
 	{
 		mCamera = cam;
+		mAllDirty = true;
 	}
 
     Camera* GraphicsEngine::getCamera() const
@@ -138,57 +174,885 @@ namespace ST
 	{
 	    ++mFrames;
 
+	    if (mThreaded && !mRenderThread)
+	    {
+	        if (!startRenderThread())
+                mThreaded = false;
+	    }
+	    else if (!mThreaded && mRenderThread)
+	    {
+	        stopRenderThread();
+	    }
+
+	    DrawList &list = mDrawLists[mRecordList];
+	    recordFrame(list);
+
+	    if (mCapture && !mCapture->recordFrame(list))
+	    {
+	        logger->logDebug("Finished capturing frames");
+	        delete mCapture;
+	        mCapture = NULL;
+	    }
+
+	    submitFrame(list);
+
+        // the next frame is recorded while this one is drawn
+        if (mRenderThread)
+            mRecordList = 1 - mRecordList;
+	}
+
+	void GraphicsEngine::submitFrame(DrawList &list)
+	{
+	    if (!mRenderThread)
+	    {
+	        drawFrame(list);
+	        return;
+	    }
+
+        // hand the frame over once the last one is drawn
+        SDL_LockMutex(mRenderMutex);
+        while (mPendingList)
+            SDL_CondWait(mRenderCond, mRenderMutex);
+        mPendingList = &list;
+        ++mFramesHanded;
+        SDL_CondBroadcast(mRenderCond);
+        SDL_UnlockMutex(mRenderMutex);
+	}
+
+	bool GraphicsEngine::startCapture(const std::string &filename, unsigned int frames)
+	{
+	    delete mCapture;
+	    mCapture = new RenderCapture;
+	    if (!mCapture->startRecording(filename, frames))
+	    {
+	        delete mCapture;
+	        mCapture = NULL;
+	        return false;
+	    }
+
+	    return true;
+	}
+
+	bool GraphicsEngine::replayCapture(const std::string &filename, unsigned int loops)
+	{
+	    RenderCapture capture;
+	    if (!capture.load(filename))
+            return false;
+
+        if (mThreaded && !mRenderThread && !startRenderThread())
+            mThreaded = false;
+
+        unsigned int frames = capture.getFrameCount() * loops;
+        unsigned int start = SDL_GetTicks();
+
+        for (unsigned int loop = 0; loop < loops; ++loop)
+        {
+            for (unsigned int i = 0; i < capture.getFrameCount(); ++i)
+                submitFrame(capture.getFrame(i));
+        }
+        finishFrame();
+
+        unsigned int time = SDL_GetTicks() - start;
+
+        std::stringstream str;
+        str << "Replayed " << frames << " frames in " << time << "ms";
+        if (frames > 0 && time > 0)
+        {
+            str << ", " << (float)time / frames << "ms per frame, "
+                << frames * 1000 / time << " fps";
+        }
+        logger->logDebug(str.str());
+
+        return true;
+	}
+
+	void GraphicsEngine::recordFrame(DrawList &list)
+	{
+	    list.commands.clear();
+	    list.screenRects.clear();
+	    list.partial = false;
+
+        // make sure the tiles around the camera have been decoded
+        if (mCamera)
+            mapEngine->updateChunks(mCamera->getViewBounds());
+
+        // baking new chunks may draw to the screen,
+        // so it has to happen before the scene is setup
+        unsigned int firstLayer = 0;
+        if (mCamera && mStaticCache)
+        {
+            updateStaticCache();
+            firstLayer = mStaticLayers;
+        }
+
+        if (mCamera && mDirtyRects && supportsDirtyRects())
+        {
+            // only draw the parts of the screen that changed,
+            // the rest is still there from the last frame
+            AG_LockVFS(&agDrivers);
+            findDirtyRects();
+            AG_UnlockVFS(&agDrivers);
+
+            Rectangle &view = mCamera->getViewBounds();
+            for (unsigned int i = 0; i < mScreenRects.size(); ++i)
+            {
+                Rectangle area = mScreenRects[i];
+                addCommand(DrawCommand::CLIP, NULL, area);
+
+                area.x += view.x;
+                area.y += view.y;
+                drawMap(firstLayer, area);
+            }
+
+            list.screenRects = mScreenRects;
+            list.partial = true;
+        }
+        else if (mCamera)
+        {
+            // Display the nodes on screen (if theres a camera to view them)
+            drawMap(firstLayer, mCamera->getViewBounds());
+        }
+	}
+
+	void GraphicsEngine::drawFrame(DrawList &list)
+	{
         AG_LockVFS(&agDrivers);
         if (agDriverSw)
             AG_BeginRendering(agDriverSw);
 
-        setupScene();
+        if (!list.partial)
+            setupScene();
 
-		// Display the nodes on screen (if theres a camera to view them)
-		if (mCamera)
+        for (unsigned int i = 0; i < list.commands.size(); ++i)
         {
-            for (unsigned int i = 0; i < mapEngine->getLayers(); ++i)
+            DrawCommand &command = list.commands[i];
+            switch (command.type)
             {
-                if (mapEngine->getLayer(i)->isCollisionLayer())
-                    continue;
-                outputNodes(i);
+                case DrawCommand::TEXTURE:
+                    drawTexturedRect(command.rect, command.texture);
+                    break;
+
+                case DrawCommand::STATIC_CHUNK:
+                    drawStaticChunk(command.rect.x, command.rect.y, command.texture);
+                    break;
+
+                case DrawCommand::CLIP:
+                    setClipArea(&command.rect);
+                    setupScene();
+                    break;
+
+                case DrawCommand::RECT:
+                    drawRect(command.rect, false);
+                    break;
+
+                case DrawCommand::FILLED_RECT:
+                    drawRect(command.rect, true);
+                    break;
             }
         }
 
-        interfaceManager->drawWindows();
+        if (list.partial)
+            setClipArea(NULL);
+
+        // with dirty rects nothing needs showing if nothing changed
+        if (!list.partial || !list.screenRects.empty())
+        {
+            // the interface draws straight to the screen
+            flushSprites();
+
+            interfaceManager->drawWindows();
 
-		endScene();
+            if (list.partial)
+                updateRects(list.screenRects);
+            else
+                endScene();
+        }
 
         if (agDriverSw)
             AG_EndRendering(agDriverSw);
         AG_UnlockVFS(&agDrivers);
 	}
 
-	void GraphicsEngine::outputNodes(int layer)
+	void GraphicsEngine::addCommand(DrawCommand::Type type, Texture *texture, const Rectangle &rect)
 	{
-	    // create iterators for looping
-        NodeItr itr = mapEngine->getLayer(layer)->getFrontNode();
-        NodeItr itr_end = mapEngine->getLayer(layer)->getEndNode();
+	    DrawCommand command;
+	    command.type = type;
+	    command.texture = texture;
+	    command.rect = rect;
+	    mDrawLists[mRecordList].commands.push_back(command);
+	}
+
+	void GraphicsEngine::addRect(const Rectangle &rect, bool filled)
+	{
+	    addCommand(filled ? DrawCommand::FILLED_RECT : DrawCommand::RECT, NULL, rect);
+	}
+
+	void GraphicsEngine::setRenderThread(bool enabled)
+	{
+	    mThreaded = enabled;
+	}
+
+	bool GraphicsEngine::startRenderThread()
+	{
+	    mQuitRender = false;
+	    mPendingList = NULL;
+	    mRenderReady = false;
+	    mRenderContext = false;
+	    mJobsQueued = 0;
+	    mJobsRun = 0;
+	    mFramesHanded = 0;
+	    mFramesDrawn = 0;
+	    mRenderMutex = SDL_CreateMutex();
+	    mRenderCond = SDL_CreateCond();
+
+	    // the context can only be current on one thread, so is let go
+	    // here for the render thread to take
+	    if (mRenderMutex && mRenderCond && makeContextCurrent(false))
+            mRenderThread = SDL_CreateThread(renderThread, this);
+
+        if (mRenderThread)
+        {
+            SDL_LockMutex(mRenderMutex);
+            while (!mRenderReady)
+                SDL_CondWait(mRenderCond, mRenderMutex);
+            SDL_UnlockMutex(mRenderMutex);
+
+            if (!mRenderContext)
+            {
+                logger->logError("Unable to use the context on the render thread");
+                SDL_WaitThread(mRenderThread, NULL);
+                mRenderThread = NULL;
+            }
+        }
+        else
+        {
+            logger->logError("Unable to create render thread");
+        }
+
+        if (!mRenderThread)
+        {
+            makeContextCurrent(true);
+            if (mRenderCond)
+                SDL_DestroyCond(mRenderCond);
+            if (mRenderMutex)
+                SDL_DestroyMutex(mRenderMutex);
+            mRenderCond = NULL;
+            mRenderMutex = NULL;
+            return false;
+        }
+
+        logger->logDebug("Drawing frames on a separate thread");
+
+        return true;
+	}
+
+	void GraphicsEngine::stopRenderThread()
+	{
+	    if (!mRenderThread)
+            return;
+
+        SDL_LockMutex(mRenderMutex);
+        mQuitRender = true;
+        SDL_CondBroadcast(mRenderCond);
+        SDL_UnlockMutex(mRenderMutex);
+
+        SDL_WaitThread(mRenderThread, NULL);
+        SDL_DestroyCond(mRenderCond);
+        SDL_DestroyMutex(mRenderMutex);
+        mRenderThread = NULL;
+        mRenderCond = NULL;
+        mRenderMutex = NULL;
+
+        // the render thread let go of the context as it ended
+        makeContextCurrent(true);
+	}
+
+	void GraphicsEngine::finishFrame()
+	{
+	    if (!mRenderThread)
+            return;
+
+        SDL_LockMutex(mRenderMutex);
+        while (mPendingList || mJobsRun != mJobsQueued || !mReleaseJobs.empty())
+            SDL_CondWait(mRenderCond, mRenderMutex);
+        SDL_UnlockMutex(mRenderMutex);
+	}
+
+	void GraphicsEngine::runOnRenderThread(Job *job, bool wait)
+	{
+	    if (!mRenderThread || SDL_ThreadID() == SDL_GetThreadID(mRenderThread))
+	    {
+	        job->run();
+	        delete job;
+	        return;
+	    }
+
+        SDL_LockMutex(mRenderMutex);
+        mRenderJobs.push_back(job);
+        unsigned int ticket = ++mJobsQueued;
+        SDL_CondBroadcast(mRenderCond);
+        if (wait)
+        {
+            while (mJobsRun < ticket)
+                SDL_CondWait(mRenderCond, mRenderMutex);
+        }
+        SDL_UnlockMutex(mRenderMutex);
+	}
+
+	void GraphicsEngine::releaseAfterFrame(Job *job)
+	{
+	    if (!mRenderThread)
+	    {
+	        job->run();
+	        delete job;
+	        return;
+	    }
 
+        SDL_LockMutex(mRenderMutex);
+        mReleaseJobs.push_back(std::make_pair(mFramesHanded, job));
+        SDL_CondBroadcast(mRenderCond);
+        SDL_UnlockMutex(mRenderMutex);
+	}
+
+	bool GraphicsEngine::releaseReady() const
+	{
+	    return !mReleaseJobs.empty() && mReleaseJobs.front().first <= mFramesDrawn;
+	}
+
+	int GraphicsEngine::renderThread(void *data)
+	{
+	    GraphicsEngine *engine = static_cast<GraphicsEngine*>(data);
+
+	    bool current = engine->makeContextCurrent(true);
+
+	    SDL_LockMutex(engine->mRenderMutex);
+	    engine->mRenderReady = true;
+	    engine->mRenderContext = current;
+	    SDL_CondBroadcast(engine->mRenderCond);
+	    if (!current)
+	    {
+	        SDL_UnlockMutex(engine->mRenderMutex);
+	        return 0;
+	    }
+
+	    while (true)
+	    {
+	        while (!engine->mPendingList && engine->mRenderJobs.empty() &&
+                   !engine->releaseReady() && !engine->mQuitRender)
+            {
+                SDL_CondWait(engine->mRenderCond, engine->mRenderMutex);
+            }
+
+            // jobs go first, a frame handed over may draw what they create
+            if (!engine->mRenderJobs.empty())
+            {
+                std::list<Job*> jobs;
+                jobs.swap(engine->mRenderJobs);
+                SDL_UnlockMutex(engine->mRenderMutex);
+
+                for (std::list<Job*>::iterator itr = jobs.begin(); itr != jobs.end(); ++itr)
+                {
+                    (*itr)->run();
+                    delete *itr;
+                }
+
+                SDL_LockMutex(engine->mRenderMutex);
+                engine->mJobsRun += jobs.size();
+                SDL_CondBroadcast(engine->mRenderCond);
+                continue;
+            }
+
+            // a frame handed over is still drawn when stopping
+            if (engine->mPendingList)
+            {
+                DrawList *list = engine->mPendingList;
+                SDL_UnlockMutex(engine->mRenderMutex);
+
+                engine->drawFrame(*list);
+
+                SDL_LockMutex(engine->mRenderMutex);
+                engine->mPendingList = NULL;
+                ++engine->mFramesDrawn;
+                SDL_CondBroadcast(engine->mRenderCond);
+                continue;
+            }
+
+            // frees wait for the frames that might draw what they free,
+            // and for the jobs before them, which may fill it in
+            if (engine->releaseReady())
+            {
+                std::list<Job*> jobs;
+                while (engine->releaseReady())
+                {
+                    jobs.push_back(engine->mReleaseJobs.front().second);
+                    engine->mReleaseJobs.pop_front();
+                }
+                SDL_UnlockMutex(engine->mRenderMutex);
+
+                for (std::list<Job*>::iterator itr = jobs.begin(); itr != jobs.end(); ++itr)
+                {
+                    (*itr)->run();
+                    delete *itr;
+                }
+
+                SDL_LockMutex(engine->mRenderMutex);
+                SDL_CondBroadcast(engine->mRenderCond);
+                continue;
+            }
+
+            break;
+	    }
+	    SDL_UnlockMutex(engine->mRenderMutex);
+
+	    engine->makeContextCurrent(false);
+
+	    return 0;
+	}
+
+	void GraphicsEngine::drawMap(unsigned int firstLayer, const Rectangle &area)
+	{
+	    if (firstLayer)
+            drawStaticCache(area);
+
+        for (unsigned int i = firstLayer; i < mapEngine->getLayers(); ++i)
+        {
+            if (mapEngine->getLayer(i)->isCollisionLayer())
+                continue;
+            outputNodes(i, area);
+        }
+	}
+
+	void GraphicsEngine::outputNodes(int layer, const Rectangle &area)
+	{
+	    Layer *l = mapEngine->getLayer(layer);
         Point pt = mCamera->getPosition();
+        Rectangle &view = mCamera->getViewBounds();
+
+        // find the tiles in the area and put them in drawing order
+        queueTiles(l, area);
+
+        // find the nodes in the area, keeping the layer's order
+        queueNodes(l, area);
 
-        // keep looping until reached the end of the list
-        while (itr != itr_end)
+        // tiles are queued relative to the area, but drawn relative to the view
+        int offsetX = area.x - view.x;
+        int offsetY = area.y - view.y;
+
+	    // create iterators for looping
+        NodeItr itr = mNodeQueue.begin();
+        NodeItr itr_end = mNodeQueue.end();
+        std::vector<TileDraw>::iterator tile = mTileQueue.begin();
+        std::vector<TileDraw>::iterator tile_end = mTileQueue.end();
+
+        // keep looping until reached the end of both lists,
+        // drawing whichever is further back first
+        while (itr != itr_end || tile != tile_end)
         {
-            Node *node = (*itr);
+            if (itr == itr_end || (tile != tile_end &&
+                tile->depth <= (*itr)->getPosition().y - (*itr)->getHeight()))
+            {
+                Rectangle rect;
+                rect.x = tile->x + offsetX;
+                rect.y = tile->y + offsetY;
+                rect.width = tile->texture->getWidth();
+                rect.height = tile->texture->getHeight();
 
-            // dont draw if not visible
-            if (!node->getVisible())
+                addCommand(DrawCommand::TEXTURE, tile->texture, rect);
+
+                ++tile;
                 continue;
+            }
+
+            Node *node = (*itr);
+            ++itr;
 
             Rectangle rect = node->getBounds();
             rect.x -= pt.x;
             rect.x -= node->getAnchor();
             rect.y -= pt.y;
 
-            drawTexturedRect(rect, node->getTexture());
+            // layered nodes draw each texture in the same place
+            unsigned int count = node->getTextureLayers(mTextureLayers, MAX_TEXTURE_LAYERS);
+            if (count)
+            {
+                for (unsigned int i = 0; i < count; ++i)
+                    addCommand(DrawCommand::TEXTURE, mTextureLayers[i], rect);
+                continue;
+            }
 
-            ++itr;
+            addCommand(DrawCommand::TEXTURE, node->getTexture(), rect);
+	    }
+	}
+
+	void GraphicsEngine::queueTiles(Layer *layer, const Rectangle &area)
+	{
+        mTileQueue.clear();
+        Point start, end;
+        if (!layer->hasTileData() || !mapEngine->getVisibleTiles(area, start, end))
+            return;
+
+        int tileWidth = mapEngine->getTileWidth();
+        int tileHeight = mapEngine->getTileHeight();
+
+        for (int y = start.y; y <= end.y; ++y)
+        {
+            for (int x = start.x; x <= end.x; ++x)
+            {
+                Texture *tex = mapEngine->getTileTexture(layer->getTileId(x, y));
+                if (!tex)
+                    continue;
+
+                TileDraw tile;
+                tile.x = 0.5 * (x - y) * tileWidth;
+                tile.y = 0.5 * (x + y) * tileHeight;
+                tile.depth = tile.y - tex->getHeight();
+                tile.x -= area.x;
+                tile.y -= area.y;
+                tile.texture = tex;
+
+                // tiles are drawn upwards from their position
+                if (tile.x >= (int)area.width || tile.x + tex->getWidth() <= 0 ||
+                    tile.y <= 0 || tile.y - tex->getHeight() >= (int)area.height)
+                    continue;
+
+                mTileQueue.push_back(tile);
+            }
+        }
+
+        std::sort(mTileQueue.begin(), mTileQueue.end());
+	}
+
+	void GraphicsEngine::queueNodes(Layer *layer, const Rectangle &area)
+	{
+	    mNodeQueue.clear();
+	    if (layer->getSize() == 0)
+            return;
+
+        // nodes are bucketed by the tile they stand on, but are drawn
+        // up and to the sides of it, so look further out for them
+        int tileWidth = mapEngine->getTileWidth();
+        int tileHeight = mapEngine->getTileHeight();
+        Rectangle bounds;
+        bounds.x = area.x - layer->getMaxNodeWidth() - tileWidth;
+        bounds.y = area.y - tileHeight;
+        bounds.width = area.width + 2 * (layer->getMaxNodeWidth() + tileWidth);
+        bounds.height = area.height + layer->getMaxNodeHeight() + 2 * tileHeight;
+
+        Point start, end;
+        if (!mapEngine->getVisibleTiles(bounds, start, end))
+            return;
+
+        layer->getNodesInArea(start, end, mCandidates);
+
+        for (unsigned int i = 0; i < mCandidates.size(); ++i)
+        {
+            Node *node = mCandidates[i];
+            if (!node->getVisible())
+                continue;
+
+            // nodes are drawn upwards from their position
+            Rectangle &rect = node->getBounds();
+            int x = rect.x - node->getAnchor() - area.x;
+            int y = rect.y - area.y;
+            if (x >= (int)area.width || x + (int)rect.width <= 0 ||
+                y <= 0 || y - (int)rect.height >= (int)area.height)
+                continue;
+
+            mNodeQueue.push_back(node);
+        }
+        mCandidates.clear();
+
+        // the buckets arent in drawing order, the layer is
+        std::sort(mNodeQueue.begin(), mNodeQueue.end(), compareSlots);
+	}
+
+	bool GraphicsEngine::compareSlots(Node *first, Node *second)
+	{
+	    return first->getLayerHandle().slot < second->getLayerHandle().slot;
+	}
+
+	void GraphicsEngine::setStaticCache(bool enabled)
+	{
+	    mStaticCache = enabled;
+	    if (!mStaticCache)
+            clearStaticCache();
+	}
+
+	void GraphicsEngine::clearStaticCache()
+	{
+	    StaticChunkItr itr = mStaticChunks.begin(), itr_end = mStaticChunks.end();
+	    while (itr != itr_end)
+	    {
+	        // the frame being drawn may still use the chunk
+	        if (itr->second)
+                itr->second->remove();
+	        ++itr;
+	    }
+	    mStaticChunks.clear();
+	    mStaticLayers = 0;
+	}
+
+	unsigned int GraphicsEngine::countStaticLayers()
+	{
+	    // beings are added to the last layer, so it is never static
+	    unsigned int count = 0;
+	    while (count + 1 < mapEngine->getLayers() &&
+               mapEngine->getLayer(count)->getSize() == 0)
+	    {
+	        ++count;
+	    }
+	    return count;
+	}
+
+	void GraphicsEngine::updateStaticCache()
+	{
+	    // chunks baked with a different set of layers are no use
+	    unsigned int layers = countStaticLayers();
+	    if (layers != mStaticLayers)
+	    {
+	        clearStaticCache();
+	        mStaticLayers = layers;
+	    }
+
+	    if (!mStaticLayers)
+            return;
+
+        Rectangle &view = mCamera->getViewBounds();
+        int startX = toStaticChunk(view.x);
+        int startY = toStaticChunk(view.y);
+        int endX = toStaticChunk(view.x + (int)view.width - 1);
+        int endY = toStaticChunk(view.y + (int)view.height - 1);
+
+        for (int y = startY; y <= endY; ++y)
+        {
+            for (int x = startX; x <= endX; ++x)
+            {
+                std::pair<int, int> key(x, y);
+                if (mStaticChunks.find(key) != mStaticChunks.end())
+                    continue;
+
+                Rectangle area;
+                area.x = x * STATIC_CHUNK_SIZE;
+                area.y = y * STATIC_CHUNK_SIZE;
+                area.width = STATIC_CHUNK_SIZE;
+                area.height = STATIC_CHUNK_SIZE;
+
+                // baking draws on the screen, which the render thread may be using
+                finishFrame();
+
+                // store failed chunks too, so they arent tried every frame
+                Texture *tex = bakeStaticChunk(area);
+                if (!tex)
+                    logger->logWarning("Unable to cache static layers");
+                mStaticChunks[key] = tex;
+            }
+        }
+	}
+
+	void GraphicsEngine::drawStaticCache(const Rectangle &area)
+	{
+        Rectangle &view = mCamera->getViewBounds();
+        int startX = toStaticChunk(area.x);
+        int startY = toStaticChunk(area.y);
+        int endX = toStaticChunk(area.x + (int)area.width - 1);
+        int endY = toStaticChunk(area.y + (int)area.height - 1);
+
+        for (int y = startY; y <= endY; ++y)
+        {
+            for (int x = startX; x <= endX; ++x)
+            {
+                StaticChunkItr itr = mStaticChunks.find(std::pair<int, int>(x, y));
+                if (itr == mStaticChunks.end() || !itr->second)
+                    continue;
+
+                Rectangle rect;
+                rect.x = x * STATIC_CHUNK_SIZE - view.x;
+                rect.y = y * STATIC_CHUNK_SIZE - view.y;
+                rect.width = STATIC_CHUNK_SIZE;
+                rect.height = STATIC_CHUNK_SIZE;
+                addCommand(DrawCommand::STATIC_CHUNK, itr->second, rect);
+            }
+        }
+	}
+
+	void GraphicsEngine::setDirtyRects(bool enabled)
+	{
+	    mDirtyRects = enabled;
+	    mDirtyAreas.clear();
+	    mAllDirty = true;
+	}
+
+	void GraphicsEngine::markDirty(const Rectangle &area)
+	{
+	    if (!mDirtyRects || mAllDirty)
+            return;
+
+        if (mDirtyAreas.size() >= MAX_DIRTY_AREAS)
+        {
+            markAllDirty();
+            return;
+        }
+
+	    mDirtyAreas.push_back(area);
+	}
+
+	void GraphicsEngine::markDirty(Node *node)
+	{
+	    if (!mDirtyRects)
+            return;
+
+        // nodes are drawn upwards from their position
+        Rectangle &bounds = node->getBounds();
+        Rectangle area;
+        area.x = bounds.x - node->getAnchor();
+        area.y = bounds.y - (int)bounds.height;
+        area.width = bounds.width;
+        area.height = bounds.height;
+        markDirty(area);
+	}
+
+	void GraphicsEngine::markAllDirty()
+	{
+	    mAllDirty = true;
+	    mDirtyAreas.clear();
+	}
+
+	void GraphicsEngine::findDirtyRects()
+	{
+	    mScreenRects.clear();
+
+	    // moving the camera moves everything on screen
+	    Rectangle &view = mCamera->getViewBounds();
+	    if (view.x != mLastCameraX || view.y != mLastCameraY)
+	    {
+	        mLastCameraX = view.x;
+	        mLastCameraY = view.y;
+	        mAllDirty = true;
+	    }
+
+	    // the interface is drawn every frame, so where it was
+	    // last frame and where it is now both need drawing
+	    for (unsigned int i = 0; i < mWindowAreas.size(); ++i)
+            addScreenRect(mWindowAreas[i]);
+        mWindowAreas.clear();
+        interfaceManager->getWindowAreas(mWindowAreas);
+	    for (unsigned int i = 0; i < mWindowAreas.size(); ++i)
+            addScreenRect(mWindowAreas[i]);
+
+        if (mAllDirty)
+        {
+            Rectangle screen;
+            screen.x = 0;
+            screen.y = 0;
+            screen.width = mWidth;
+            screen.height = mHeight;
+            mScreenRects.clear();
+            mScreenRects.push_back(screen);
+
+            mAllDirty = false;
+            mDirtyAreas.clear();
+            return;
+        }
+
+        for (unsigned int i = 0; i < mDirtyAreas.size(); ++i)
+        {
+            Rectangle rect = mDirtyAreas[i];
+            rect.x -= view.x;
+            rect.y -= view.y;
+            addScreenRect(rect);
+        }
+        mDirtyAreas.clear();
+	}
+
+	void GraphicsEngine::addScreenRect(Rectangle rect)
+	{
+	    // clip to the screen
+	    int left = std::max(rect.x, 0);
+	    int top = std::max(rect.y, 0);
+	    int right = std::min(rect.x + (int)rect.width, mWidth);
+	    int bottom = std::min(rect.y + (int)rect.height, mHeight);
+	    if (left >= right || top >= bottom)
+            return;
+
+        // join with any it overlaps, the joined rect may overlap others
+        unsigned int i = 0;
+        while (i < mScreenRects.size())
+        {
+            Rectangle &other = mScreenRects[i];
+            int otherRight = other.x + (int)other.width;
+            int otherBottom = other.y + (int)other.height;
+            if (left > otherRight || right < other.x ||
+                top > otherBottom || bottom < other.y)
+            {
+                ++i;
+                continue;
+            }
+
+            left = std::min(left, other.x);
+            top = std::min(top, other.y);
+            right = std::max(right, otherRight);
+            bottom = std::max(bottom, otherBottom);
+            mScreenRects.erase(mScreenRects.begin() + i);
+            i = 0;
+        }
+
+        rect.x = left;
+        rect.y = top;
+        rect.width = right - left;
+        rect.height = bottom - top;
+        mScreenRects.push_back(rect);
+
+        // too many separate rects, draw the area around them all instead
+        if (mScreenRects.size() > MAX_SCREEN_RECTS)
+        {
+            for (i = 0; i < mScreenRects.size(); ++i)
+            {
+                const Rectangle &other = mScreenRects[i];
+                left = std::min(left, other.x);
+                top = std::min(top, other.y);
+                right = std::max(right, other.x + (int)other.width);
+                bottom = std::max(bottom, other.y + (int)other.height);
+            }
+
+            rect.x = left;
+            rect.y = top;
+            rect.width = right - left;
+            rect.height = bottom - top;
+            mScreenRects.clear();
+            mScreenRects.push_back(rect);
+        }
+	}
+
+	int GraphicsEngine::toStaticChunk(int pos)
+	{
+	    // the map goes left of zero, so negative positions are common
+	    if (pos < 0)
+            return (pos + 1) / STATIC_CHUNK_SIZE - 1;
+	    return pos / STATIC_CHUNK_SIZE;
+	}
+
+	void GraphicsEngine::drawStaticTiles(const Rectangle &area)
+	{
+	    for (unsigned int i = 0; i < mStaticLayers; ++i)
+	    {
+	        Layer *layer = mapEngine->getLayer(i);
+	        if (layer->isCollisionLayer())
+                continue;
+
+            queueTiles(layer, area);
+
+            std::vector<TileDraw>::iterator tile = mTileQueue.begin();
+            std::vector<TileDraw>::iterator tile_end = mTileQueue.end();
+            for (; tile != tile_end; ++tile)
+            {
+                Rectangle rect;
+                rect.x = tile->x;
+                rect.y = tile->y;
+                rect.width = tile->texture->getWidth();
+                rect.height = tile->texture->getHeight();
+
+                drawTexturedRect(rect, tile->texture);
+            }
 	    }
 	}
 
@@ -261,7 +1125,13 @@ namespace ST
         return loadTextureSet(name, name, w, h);
     }
 
-    bool GraphicsEngine::loadTextureSet(const std::string &name, const std::string &file, int w, int h)
+    bool GraphicsEngine::loadTextureSet(const std::string &name, int w, int h, std::vector<Texture*> &textures)
+    {
+        return loadTextureSet(name, name, w, h, &textures);
+    }
+
+    bool GraphicsEngine::loadTextureSet(const std::string &name, const std::string &file, int w, int h,
+                                        std::vector<Texture*> *textures)
 	{
 		// Load in the texture set
 		SDL_Surface *s = IMG_Load(file.c_str());
@@ -280,7 +1150,13 @@ namespace ST
 					{
                         std::stringstream str;
                         str << name << id;
-						createTexture(s, str.str(), j*w, i*h, w, h);
+
+                        // reuse the texture if this set was loaded before
+                        Texture *tex = getTexture(str.str());
+                        if (!tex)
+                            tex = createTexture(s, str.str(), j*w, i*h, w, h, true);
+                        if (textures)
+                            textures->push_back(tex);
                         ++id;
 					}
 				}
@@ -342,7 +1218,7 @@ namespace ST
 					{
                         std::stringstream str;
                         str << name << id;
-						createTexture(s, str.str(), j*w, i*h, w, h);
+						createTexture(s, str.str(), j*w, i*h, w, h, true);
                         ++id;
 					}
 				}
@@ -377,7 +1253,8 @@ namespace ST
 
 	Texture* GraphicsEngine::createTexture(SDL_Surface *surface, std::string name,
 									   unsigned int x, unsigned int y,
-									   unsigned int width, unsigned int height)
+									   unsigned int width, unsigned int height,
+									   bool atlas)
 	{
 		// Set the byte order of RGBA
 		Uint32 rmask, gmask, bmask, amask;
@@ -435,12 +1312,16 @@ namespace ST
 		}
 		if (mOpenGL)
 		{
-			texture->setPixels(tex);
+		    // frames that dont fit in the atlas get their own texture
+		    if (atlas && !mAtlas)
+                mAtlas = new TextureAtlas;
+		    if (!atlas || !mAtlas->addTexture(texture, tex))
+                texture->setPixels(tex);
 			SDL_FreeSurface(tex);
 		}
 		else
 		{
-            texture->setImage(tex);
+            texture->setImage(toDisplayFormat(tex));
 		}
 
 		mTextures.insert(std::pair<std::string, Texture*>(texture->getName(),
@@ -449,6 +1330,28 @@ namespace ST
 		return texture;
 	}
 
+	void GraphicsEngine::startAtlasPage()
+	{
+	    if (mAtlas)
+            mAtlas->startPage();
+	}
+
+	SDL_Surface* GraphicsEngine::toDisplayFormat(SDL_Surface *surface)
+	{
+	    // converting once here saves converting the pixels on every blit
+	    SDL_Surface *display = SDL_DisplayFormatAlpha(surface);
+	    if (display)
+	    {
+	        SDL_FreeSurface(surface);
+	        surface = display;
+	    }
+
+	    // run length encode the transparent pixels now, so blits dont have to
+	    SDL_SetAlpha(surface, SDL_SRCALPHA | SDL_RLEACCEL, SDL_ALPHA_OPAQUE);
+
+	    return surface;
+	}
+
 	unsigned int GraphicsEngine::getPixel(SDL_Surface *s, int x, int y) const
 	{
 		// Lock the surface so we can get pixels from it
@@ -565,7 +1468,70 @@ namespace ST
         return createAvatarFrame(id, 0, textures, dir);
     }
 
+    Texture* GraphicsEngine::createBeingTexture(unsigned int id, const std::map<int, int> &partIds, int dir)
+    {
+        // the parts are drawn separately, the body gives the being its size
+        if (drawLayeredAvatars())
+        {
+            std::map<int, int>::const_iterator itr = partIds.find(PART_BODY);
+            BodyPart *part = NULL;
+            if (itr != partIds.end())
+                part = resourceManager->getBodyPart(itr->second);
+            if (part && part->getTexture(dir))
+                return part->getTexture(dir);
+        }
+
+        return createAvatar(id, partIds, dir);
+    }
+
     Texture* GraphicsEngine::createAvatarFrame(unsigned int id, unsigned int frame, const std::map<int, Texture*> &textures, int dir)
+    {
+        std::stringstream str;
+        str << "Being" << id << "_" << dir << "_" << frame;
+
+        TextureItr itr = mTextures.find(str.str());
+        if (itr != mTextures.end())
+        {
+            // nodes and animations may still be using the old frame
+            itr->second->remove();
+            mTextures.erase(itr);
+        }
+
+        Texture *tex = composeAvatar(str.str(), textures);
+
+        mTextures.insert(std::pair<std::string, Texture*>(tex->getName(), tex));
+        return tex;
+    }
+
+    Texture* GraphicsEngine::getAvatarFrame(const AvatarKey &key, const std::map<int, Texture*> &textures)
+    {
+        Texture *tex = mAvatarCache->getFrame(key);
+        if (tex)
+            return tex;
+
+        // the cache owns the frame, so its not kept by name with the others
+        std::stringstream str;
+        str << "Avatar" << key.body << "_" << key.hair << "_" << key.chest << "_"
+            << key.legs << "_" << key.feet << "_" << key.animation << "_"
+            << key.direction << "_" << key.frame;
+
+        tex = composeAvatar(str.str(), textures);
+        mAvatarCache->addFrame(key, tex);
+
+        return tex;
+    }
+
+    void GraphicsEngine::setAvatarCacheBudget(unsigned int budget)
+    {
+        mAvatarCache->setBudget(budget);
+    }
+
+    unsigned int GraphicsEngine::getAvatarCacheBudget() const
+    {
+        return mAvatarCache->getBudget();
+    }
+
+    Texture* GraphicsEngine::composeAvatar(const std::string &name, const std::map<int, Texture*> &textures)
     {
         // Set the byte order of RGBA
         Uint32 rmask, gmask, bmask, amask;
@@ -581,20 +1547,28 @@ namespace ST
         amask = 0xff000000;
 #endif
 
-        std::stringstream str;
-        str << "Being" << id << "_" << dir << "_" << frame;
-
-        TextureItr itr = mTextures.find(str.str());
-        if (itr != mTextures.end())
-        {
-            delete itr->second;
-            mTextures.erase(itr);
-        }
-
         int bodyWidth = resourceManager->getBodyWidth();
         int bodyHeight = resourceManager->getBodyHeight();
 
-		Texture *tex = new Texture(str.str(), bodyWidth, bodyHeight);
+		Texture *tex = new Texture(name, bodyWidth, bodyHeight);
+
+        // blending from the pixels already in memory
+        // saves reading the parts back from OpenGL
+        SDL_Surface *composed = composeParts(textures, bodyWidth, bodyHeight);
+        if (composed)
+        {
+            if (mOpenGL)
+            {
+                tex->setPixels(composed);
+                SDL_FreeSurface(composed);
+            }
+            else
+            {
+                tex->setImage(toDisplayFormat(composed));
+            }
+
+            return tex;
+        }
 
         // write all the textures to the surface
         // start with the body as the base
@@ -607,31 +1581,31 @@ namespace ST
 
             if (textures.find(PART_BODY) != textures.end())
             {
-                SDL_Surface *s = createSurface(textures.find(PART_BODY)->second->getGLTexture(), bodyWidth, bodyHeight);
+                SDL_Surface *s = createSurface(textures.find(PART_BODY)->second, bodyWidth, bodyHeight);
                 SDL_SetAlpha(s, 0, 255);
                 SDL_BlitSurface(s, NULL, surface, NULL);
             }
             if (textures.find(PART_HAIR) != textures.end())
             {
-                SDL_Surface *s = createSurface(textures.find(PART_HAIR)->second->getGLTexture(), bodyWidth, bodyHeight);
+                SDL_Surface *s = createSurface(textures.find(PART_HAIR)->second, bodyWidth, bodyHeight);
                 SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(s, NULL, surface, NULL);
             }
             if (textures.find(PART_LEGS) != textures.end())
             {
-                SDL_Surface *s = createSurface(textures.find(PART_LEGS)->second->getGLTexture(), bodyWidth, bodyHeight);
+                SDL_Surface *s = createSurface(textures.find(PART_LEGS)->second, bodyWidth, bodyHeight);
                 SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(s, NULL, surface, NULL);
             }
             if (textures.find(PART_CHEST) != textures.end())
             {
-                SDL_Surface *s = createSurface(textures.find(PART_CHEST)->second->getGLTexture(), bodyWidth, bodyHeight);
+                SDL_Surface *s = createSurface(textures.find(PART_CHEST)->second, bodyWidth, bodyHeight);
                 SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(s, NULL, surface, NULL);
             }
             if (textures.find(PART_FEET) != textures.end())
             {
-                SDL_Surface *s = createSurface(textures.find(PART_FEET)->second->getGLTexture(), bodyWidth, bodyHeight);
+                SDL_Surface *s = createSurface(textures.find(PART_FEET)->second, bodyWidth, bodyHeight);
                 SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(s, NULL, surface, NULL);
             }
@@ -646,39 +1620,117 @@ namespace ST
                 bodyWidth, bodyHeight,
                 mScreen->format->BitsPerPixel, rmask, gmask, bmask, amask);
 
+            // the body is copied with its alpha, then put back how
+            // toDisplayFormat left it, the other parts blend over it
             if (textures.find(PART_BODY) != textures.end())
             {
                 SDL_SetAlpha(textures.find(PART_BODY)->second->getSDLSurface(), 0, 255);
                 SDL_BlitSurface(textures.find(PART_BODY)->second->getSDLSurface(), NULL, surface, NULL);
+                SDL_SetAlpha(textures.find(PART_BODY)->second->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, SDL_ALPHA_OPAQUE);
             }
             if (textures.find(PART_HAIR) != textures.end())
             {
-                SDL_SetAlpha(textures.find(PART_HAIR)->second->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(textures.find(PART_HAIR)->second->getSDLSurface(), NULL, surface, NULL);
             }
             if (textures.find(PART_LEGS) != textures.end())
             {
-                SDL_SetAlpha(textures.find(PART_LEGS)->second->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(textures.find(PART_LEGS)->second->getSDLSurface(), NULL, surface, NULL);
             }
             if (textures.find(PART_CHEST) != textures.end())
             {
-                SDL_SetAlpha(textures.find(PART_CHEST)->second->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(textures.find(PART_CHEST)->second->getSDLSurface(), NULL, surface, NULL);
             }
             if (textures.find(PART_FEET) != textures.end())
             {
-                SDL_SetAlpha(textures.find(PART_FEET)->second->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, 0);
                 SDL_BlitSurface(textures.find(PART_FEET)->second->getSDLSurface(), NULL, surface, NULL);
             }
-            tex->setImage(surface);
+            tex->setImage(toDisplayFormat(surface));
         }
 
-        mTextures.insert(std::pair<std::string, Texture*>(tex->getName(), tex));
         return tex;
     }
 
 
+    SDL_Surface* GraphicsEngine::composeParts(const std::map<int, Texture*> &textures, int width, int height)
+    {
+        // the parts in the order they are layered
+        static const int order[] = { PART_BODY, PART_HAIR, PART_LEGS, PART_CHEST, PART_FEET };
+        static const int parts = sizeof(order) / sizeof(order[0]);
+
+        CompositeLayer layers[parts];
+        int count = 0;
+        bool hasBody = false;
+        SDL_PixelFormat *format = NULL;
+
+        for (int i = 0; i < parts; ++i)
+        {
+            std::map<int, Texture*>::const_iterator itr = textures.find(order[i]);
+            if (itr == textures.end())
+                continue;
+
+            Texture *texture = itr->second;
+            if (!texture || texture->getWidth() < width || texture->getHeight() < height)
+                return NULL;
+
+            // with OpenGL the frames are kept in the atlas pages, without
+            // it they are run length encoded so are read from a decoded copy
+            SDL_Surface *surface = texture->getDecodedSurface();
+            int x = 0;
+            int y = 0;
+            AtlasPage *page = texture->getAtlasPage();
+            if (page)
+            {
+                surface = page->surface;
+                x = texture->getAtlasX();
+                y = texture->getAtlasY();
+            }
+
+            if (!surface || !surface->pixels || SDL_MUSTLOCK(surface) ||
+                surface->format->BytesPerPixel != 4 || !surface->format->Amask)
+                return NULL;
+
+            if (!format)
+            {
+                format = surface->format;
+            }
+            else if (format->Rmask != surface->format->Rmask ||
+                     format->Gmask != surface->format->Gmask ||
+                     format->Bmask != surface->format->Bmask ||
+                     format->Amask != surface->format->Amask)
+            {
+                return NULL;
+            }
+
+            layers[count].pixels = (const unsigned int*)((Uint8*)surface->pixels + y * surface->pitch) + x;
+            layers[count].pitch = surface->pitch / 4;
+            if (order[i] == PART_BODY)
+                hasBody = true;
+            ++count;
+        }
+
+        if (!format)
+            return NULL;
+
+        SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+            format->Rmask, format->Gmask, format->Bmask, format->Amask);
+        if (!surface)
+            return NULL;
+
+        // the body is copied as it is, the other parts blend over it
+        if (hasBody)
+        {
+            compositeLayers((unsigned int*)surface->pixels, surface->pitch / 4, width, height,
+                            &layers[0], &layers[1], count - 1, format->Ashift);
+        }
+        else
+        {
+            compositeLayers((unsigned int*)surface->pixels, surface->pitch / 4, width, height,
+                            NULL, layers, count, format->Ashift);
+        }
+
+        return surface;
+    }
+
 	Node* GraphicsEngine::getNode(int x, int y)
     {
         Point pt; pt.x = x; pt.y = y;
@@ -691,7 +1743,7 @@ namespace ST
             while (itr != itr_end)
             {
                 Node *node = *itr;
-                if (checkInside(pt, node->getBounds()))
+                if (node && checkInside(pt, node->getBounds()))
                 {
                     return node;
                 }
@@ -702,13 +1754,13 @@ namespace ST
         return NULL;
     }
 
-    Node* GraphicsEngine::getTile(int x, int y)
+    int GraphicsEngine::getTileId(int x, int y)
     {
         Point pt;
         pt.x = x + mCamera->getPosition().x;
         pt.y = y + mCamera->getPosition().y;
-;
-        return mapEngine->getTile(pt);
+
+        return mapEngine->getTileId(pt);
     }
 
     void GraphicsEngine::setCameraToShow(const Point &pt, int delay)
@@ -749,14 +1801,4 @@ namespace ST
     {
         return mAverageFPS;
     }
-
-    void GraphicsEngine::sort()
-    {
-        for (unsigned int i = 0; i < mapEngine->getLayers(); ++i)
-        {
-            if (mapEngine->getLayer(i)->isCollisionLayer())
-                continue;
-            mapEngine->getLayer(i)->sortNodes(0, mapEngine->getLayer(i)->getSize());
-        }
-    }
 }
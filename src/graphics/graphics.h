@@ -44,13 +44,20 @@
 #ifndef ST_GRAPHICS_HEADER
 #define ST_GRAPHICS_HEADER
 
+#include "drawlist.h"
+#include "../utilities/types.h"
+
 #include <list>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct ag_surface;
 struct SDL_Surface;
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
 
 namespace ST
 {
@@ -61,8 +68,12 @@ namespace ST
 	class Texture;
 	class Camera;
 	class GameState;
-	struct Point;
-	struct Rectangle;
+	class Layer;
+	class TextureAtlas;
+	class RenderCapture;
+	class AvatarCache;
+	class Job;
+	struct AvatarKey;
 
 	class GraphicsEngine
 	{
@@ -133,22 +144,151 @@ namespace ST
 		/**
 		 * Render Frame
 		 * Renders a single frame to the screen
+		 * With a render thread the frame is recorded and handed over,
+		 * and is drawn while the next frame is updated
 		 */
 		void renderFrame();
 
+		/**
+		 * Set Render Thread
+		 * When enabled frames are drawn on their own thread, so drawing
+		 * overlaps with updating the next frame. With OpenGL the thread
+		 * takes over the context, and Agar must be built with thread support
+		 * @param enabled Whether to draw on a separate thread
+		 */
+		void setRenderThread(bool enabled);
+
+		/**
+		 * Get Render Thread
+		 * Returns whether frames are drawn on a separate thread
+		 */
+		bool getRenderThread() const { return mThreaded; }
+
+		/**
+		 * Finish Frame
+		 * Waits until the render thread has drawn the last frame and run
+		 * the queued jobs, call before freeing anything the frame might
+		 * still draw or reading anything a job fills in
+		 */
+		void finishFrame();
+
+		/**
+		 * Run On Render Thread
+		 * Runs the job on the render thread, which is the only one that can
+		 * use the OpenGL context. Without a render thread it runs straight away.
+		 * Queued jobs run before the next frame is drawn
+		 * @param job The job to run, it is deleted once it has run
+		 * @param wait Whether to wait for the job, for jobs giving back a result
+		 */
+		void runOnRenderThread(Job *job, bool wait = false);
+
+		/**
+		 * Release After Frame
+		 * Runs the job on the render thread once the frames handed over
+		 * so far are drawn, for freeing what they might still draw.
+		 * Without a render thread it runs straight away
+		 * @param job The job to run, it is deleted once it has run
+		 */
+		void releaseAfterFrame(Job *job);
+
+		/**
+		 * Start Capture
+		 * Saves the draw commands of the next frames to a file,
+		 * so they can be replayed without a server
+		 * @param filename The file to save to
+		 * @param frames How many frames to save
+		 * @return Returns false if the file couldnt be created
+		 */
+		bool startCapture(const std::string &filename, unsigned int frames);
+
+		/**
+		 * Replay Capture
+		 * Draws the frames saved by startCapture as fast as possible,
+		 * and logs how long they took
+		 * @param filename The capture to replay
+		 * @param loops How many times to draw the capture
+		 * @return Returns false if the capture couldnt be loaded
+		 */
+		bool replayCapture(const std::string &filename, unsigned int loops);
+
 		/**
 		 * Display Nodes
-		 * This puts the nodes on screen
-		 * It loops through all the nodes and draws them if visible
+		 * This queues the tiles and nodes of a layer to be drawn
+		 * Tiles that can be seen are drawn in between the nodes,
+		 * in the same depth order the layers keep their nodes in
          * @param layer The layer to output
+         * @param area The part of the camera's view to draw, in map pixels
+		 */
+		void outputNodes(int layer, const Rectangle &area);
+
+		/**
+		 * Set Static Cache
+		 * When enabled the layers below the beings are drawn once into
+		 * cached chunks, and each frame only draws the chunks on screen
+		 * @param enabled Whether to use the cache
 		 */
-		void outputNodes(int layer);
+		void setStaticCache(bool enabled);
+
+		/**
+		 * Get Static Cache
+		 * Returns whether the static layers are cached
+		 */
+		bool getStaticCache() const { return mStaticCache; }
+
+		/**
+		 * Clear Static Cache
+		 * Frees all the cached chunks, call when the map changes
+		 */
+		void clearStaticCache();
+
+		/**
+		 * Set Dirty Rects
+		 * When enabled only the parts of the screen that changed are
+		 * drawn and updated, if the renderer supports it
+		 * @param enabled Whether to track changes
+		 */
+		void setDirtyRects(bool enabled);
+
+		/**
+		 * Get Dirty Rects
+		 * Returns whether only the changed parts of the screen are drawn
+		 */
+		bool getDirtyRects() const { return mDirtyRects; }
+
+		/**
+		 * Mark Dirty
+		 * Marks an area of the map as needing to be drawn again
+		 * @param area The area in map pixels
+		 */
+		void markDirty(const Rectangle &area);
+
+		/**
+		 * Mark Dirty
+		 * Marks where a node is drawn as needing to be drawn again,
+		 * call before and after anything that changes how it looks
+		 * @param node The node that is changing
+		 */
+		void markDirty(Node *node);
+
+		/**
+		 * Mark All Dirty
+		 * The whole screen will be drawn next frame
+		 */
+		void markAllDirty();
 
 		/**
 		 * Draw Untextured Rectangle
+		 * Draws straight away, use addRect while a frame is recorded
 		 */
 		virtual void drawRect(Rectangle &rect, bool filled) = 0;
 
+		/**
+		 * Add Untextured Rectangle
+		 * Adds the rectangle to the frame being recorded, so its drawn
+		 * in order with the map and saved in captures
+		 */
+		void addRect(const Rectangle &rect, bool filled);
+
 		/**
 		 * Draw Textured Rectangle
 		 */
@@ -165,7 +305,9 @@ namespace ST
 		Texture* loadTexture(const std::string &name);
 		Texture* loadTexture(const std::string &name, char *data, int size);
 		bool loadTextureSet(const std::string &name, int w, int h);
-        bool loadTextureSet(const std::string &name, const std::string &file, int w, int h);
+        bool loadTextureSet(const std::string &name, int w, int h, std::vector<Texture*> &textures);
+        bool loadTextureSet(const std::string &name, const std::string &file, int w, int h,
+                            std::vector<Texture*> *textures = NULL);
         bool loadTextureSet(const std::string &name, char *data, int size, int w, int h);
 		SDL_Surface* loadSDLTexture(const std::string &name);
 
@@ -175,17 +317,27 @@ namespace ST
 		 * @param surface The surface of the texture
 		 * @param width The width of the texture
 		 * @param height The height of the texture
+		 * @param atlas Whether to pack the texture into the texture atlas,
+		 * only used with OpenGL
 		 * @return Returns the texture created
 		 */
 		Texture* createTexture(SDL_Surface *surface, std::string name,
 						   unsigned int x, unsigned int y,
-						   unsigned int width, unsigned height);
+						   unsigned int width, unsigned height,
+						   bool atlas = false);
+
+		/**
+		 * Start Atlas Page
+		 * Textures packed into the atlas after this go on a new page
+		 */
+		void startAtlasPage();
 
 		/**
 		 * Create Surface
-		 * Creates a new SDL_Surface from a GL texture
+		 * Creates a new SDL_Surface from the pixels of a GL texture,
+		 * reading from the atlas when the texture is on a page
 		 */
-		virtual SDL_Surface* createSurface(unsigned int texture, int width, int height) = 0;
+		virtual SDL_Surface* createSurface(Texture *texture, int width, int height) = 0;
 
 		/**
 		 * Get Pixel
@@ -222,15 +374,65 @@ namespace ST
         Texture* createAvatar(unsigned int id, const std::map<int, int> &partIds, int dir);
         Texture* createAvatarFrame(unsigned int id, unsigned int frame, const std::map<int, Texture*> &textures, int dir);
 
+        /**
+         * Get Avatar Frame
+         * Returns the frame from the avatar cache, composing it from
+         * the body part textures the first time its needed
+         * @param key What the frame looks like
+         * @param textures The body part textures, keyed by part
+         */
+        Texture* getAvatarFrame(const AvatarKey &key, const std::map<int, Texture*> &textures);
+
+        /**
+         * Set Avatar Cache Budget
+         * Sets how many bytes of avatar frames to keep before
+         * freeing the least recently used
+         */
+        void setAvatarCacheBudget(unsigned int budget);
+
+        /**
+         * Get Avatar Cache Budget
+         * Returns how many bytes of avatar frames are kept
+         */
+        unsigned int getAvatarCacheBudget() const;
+
+        /**
+         * Set Layered Avatars
+         * When enabled beings are drawn as a stack of body part textures
+         * rather than composing them, if the renderer supports it
+         * @param enabled Whether to draw the parts separately
+         */
+        void setLayeredAvatars(bool enabled) { mLayeredAvatars = enabled; }
+
+        /**
+         * Get Layered Avatars
+         * Returns whether layered avatars are enabled
+         */
+        bool getLayeredAvatars() const { return mLayeredAvatars; }
+
+        /**
+         * Draw Layered Avatars
+         * Returns whether beings are drawn as a stack of body parts,
+         * which needs them enabled and a renderer that supports it
+         */
+        bool drawLayeredAvatars() const { return mLayeredAvatars && supportsLayeredAvatars(); }
+
+        /**
+         * Create Being Texture
+         * Returns the texture for a being in the world to start with.
+         * With layered avatars its the body part, so nothing is created
+         */
+        Texture* createBeingTexture(unsigned int id, const std::map<int, int> &partIds, int dir);
+
         /**
          * Get the node at that position
          */
         Node* getNode(int x, int y);
 
         /**
-         * Get the tile at that position
+         * Get the id of the ground tile at that screen position
          */
-        Node* getTile(int x, int y);
+        int getTileId(int x, int y);
 
         /**
          * Set Camera to Show a Point on screen
@@ -252,11 +454,6 @@ namespace ST
          */
         unsigned int getFPS();
 
-        /**
-         * Sort the nodes
-         */
-        void sort();
-
 	protected:
 		SDL_Surface *mScreen;
 		int mWidth;
@@ -266,6 +463,81 @@ namespace ST
 		virtual void setupScene() = 0;
 		virtual void endScene() = 0;
 
+		/**
+		 * Flush Sprites
+		 * Backends that batch drawTexturedRect must draw everything
+		 * queued so far, before anything else draws to the screen
+		 */
+		virtual void flushSprites() {}
+
+		/**
+		 * Supports Dirty Rects
+		 * Returns whether the renderer can update parts of the screen
+		 * and keeps what was drawn in the previous frame
+		 */
+		virtual bool supportsDirtyRects() const { return false; }
+
+		/**
+		 * Set Clip Area
+		 * Limits drawing to an area of the screen, NULL for the whole screen
+		 */
+		virtual void setClipArea(const Rectangle *area) {}
+
+		/**
+		 * Update Rects
+		 * Shows the areas of the screen that were drawn, used instead of
+		 * endScene when only the dirty parts of the screen were drawn
+		 */
+		virtual void updateRects(const std::vector<Rectangle> &rects) {}
+
+		/**
+		 * Supports Layered Avatars
+		 * Returns whether drawing each body part separately is
+		 * cheap enough, it needs the parts batched together
+		 */
+		virtual bool supportsLayeredAvatars() const { return false; }
+
+		/**
+		 * Bake Static Chunk
+		 * Creates a STATIC_CHUNK_SIZE square texture holding
+		 * the static layers inside the area, using drawStaticTiles
+		 * @param area The area of the map in pixels
+		 * @return Returns the texture, or NULL if it couldnt be created
+		 */
+		virtual Texture* bakeStaticChunk(const Rectangle &area) = 0;
+
+		/**
+		 * Draw Static Chunk
+		 * Draws a chunk made by bakeStaticChunk with its top left at x, y
+		 */
+		virtual void drawStaticChunk(int x, int y, Texture *texture) = 0;
+
+		/**
+		 * Draw Static Tiles
+		 * Draws the tiles of the static layers inside the area,
+		 * relative to the top left of the area
+		 */
+		void drawStaticTiles(const Rectangle &area);
+
+		/**
+		 * Stop Render Thread
+		 * Waits for the last frame then ends the render thread,
+		 * renderers must call this in their destructor
+		 */
+		void stopRenderThread();
+
+		/**
+		 * Make Context Current
+		 * Makes the renderer's context current on the calling thread, or
+		 * releases it from the calling thread so another can take it
+		 * @param current Whether to take or release the context
+		 * @return Returns false if the context couldnt be moved
+		 */
+		virtual bool makeContextCurrent(bool current) { return true; }
+
+		// width and height in pixels of each cached chunk
+		enum { STATIC_CHUNK_SIZE = 256 };
+
 	private:
         Camera *mCamera;
 		unsigned int mFrames;
@@ -275,6 +547,211 @@ namespace ST
 
         typedef std::vector<Node*>::iterator NodeItr;
 
+        /**
+         * Queue Tiles
+         * Puts the tiles of the layer inside the area into mTileQueue
+         * in drawing order, with positions relative to the area
+         */
+        void queueTiles(Layer *layer, const Rectangle &area);
+
+        /**
+         * Queue Nodes
+         * Puts the visible nodes of the layer inside the area
+         * into mNodeQueue, in the same order as the layer
+         */
+        void queueNodes(Layer *layer, const Rectangle &area);
+
+        /**
+         * To Display Format
+         * Converts a surface for blitting to the screen,
+         * frees the surface passed in if it was converted
+         * @return Returns the surface to use
+         */
+        SDL_Surface* toDisplayFormat(SDL_Surface *surface);
+
+        /**
+         * Compose Avatar
+         * Draws the body part textures on top of each other into a new texture
+         * @param name The name of the texture to create
+         * @param textures The body part textures, keyed by part
+         */
+        Texture* composeAvatar(const std::string &name, const std::map<int, Texture*> &textures);
+
+        /**
+         * Compose Parts
+         * Blends the body parts in one pass straight from their pixels
+         * @return Returns the new surface, or NULL if a part's pixels
+         *         cant be read directly and they need blitting instead
+         */
+        SDL_Surface* composeParts(const std::map<int, Texture*> &textures, int width, int height);
+
+        /**
+         * Draw Map
+         * Draws the static cache and layers inside an area of the view
+         * @param firstLayer The first layer that isnt cached
+         * @param area The area in map pixels
+         */
+        void drawMap(unsigned int firstLayer, const Rectangle &area);
+
+        /**
+         * Record Frame
+         * Puts the commands to draw the map into the list,
+         * anything that needs the map or camera is done here
+         */
+        void recordFrame(DrawList &list);
+
+        /**
+         * Draw Frame
+         * Draws a recorded frame and the interface, then shows it
+         */
+        void drawFrame(DrawList &list);
+
+        /**
+         * Submit Frame
+         * Hands the list to the render thread, or draws it if there isnt one
+         */
+        void submitFrame(DrawList &list);
+
+        /**
+         * Add Command
+         * Adds a command to the list being recorded
+         */
+        void addCommand(DrawCommand::Type type, Texture *texture, const Rectangle &rect);
+
+        /**
+         * Start Render Thread
+         * Creates the thread that draws frames handed over by renderFrame
+         */
+        bool startRenderThread();
+
+        /**
+         * Render Thread
+         * Draws each frame handed over until told to stop
+         */
+        static int renderThread(void *data);
+
+        /**
+         * Release Ready
+         * Whether the oldest release job's frame has been drawn,
+         * the render mutex must be held
+         */
+        bool releaseReady() const;
+
+        /**
+         * Find Dirty Rects
+         * Puts the parts of the screen that need drawing into mScreenRects,
+         * either from the areas marked dirty or the whole screen
+         */
+        void findDirtyRects();
+
+        /**
+         * Add Screen Rect
+         * Adds an area of the screen to mScreenRects,
+         * joining it with any it overlaps
+         */
+        void addScreenRect(Rectangle rect);
+
+        /**
+         * Compare Slots
+         * Returns whether the first node comes before the second in its layer
+         */
+        static bool compareSlots(Node *first, Node *second);
+
+        /**
+         * Count Static Layers
+         * Returns how many layers from the bottom never change,
+         * the last layer and any layers with nodes can change
+         */
+        unsigned int countStaticLayers();
+
+        /**
+         * Update Static Cache
+         * Bakes the chunks on screen that arent cached yet
+         */
+        void updateStaticCache();
+
+        /**
+         * Draw Static Cache
+         * Draws the cached chunks inside the area on screen
+         */
+        void drawStaticCache(const Rectangle &area);
+
+        /**
+         * To Static Chunk
+         * Returns the chunk holding the pixel position, rounding down
+         */
+        static int toStaticChunk(int pos);
+
+        // a tile waiting to be drawn by outputNodes
+        struct TileDraw
+        {
+            int x;
+            int y;
+            int depth; // same as the sort order of nodes
+            Texture *texture;
+
+            bool operator<(const TileDraw &other) const
+            {
+                return depth < other.depth;
+            }
+        };
+        std::vector<TileDraw> mTileQueue; // kept to save allocating each frame
+        std::vector<Node*> mNodeQueue;
+        std::vector<Node*> mCandidates; // nodes in the buckets near the screen
+
+        // textures of the node being drawn, for nodes drawn in layers
+        enum { MAX_TEXTURE_LAYERS = 8 };
+        Texture *mTextureLayers[MAX_TEXTURE_LAYERS];
+
+        // chunks of the static layers, keyed by their position in chunks
+        bool mStaticCache;
+        unsigned int mStaticLayers;
+        std::map<std::pair<int, int>, Texture*> mStaticChunks;
+        typedef std::map<std::pair<int, int>, Texture*>::iterator StaticChunkItr;
+
+        // pages holding the frames of texture sets, created when first needed
+        TextureAtlas *mAtlas;
+
+        // areas of the map changed since the last frame
+        bool mDirtyRects;
+        bool mAllDirty;
+        std::vector<Rectangle> mDirtyAreas;
+        std::vector<Rectangle> mScreenRects; // the parts of the screen to draw this frame
+        std::vector<Rectangle> mWindowAreas; // where the interface was drawn last frame
+        int mLastCameraX;
+        int mLastCameraY;
+
+        // past these, drawing everything is cheaper than tracking each change
+        enum { MAX_DIRTY_AREAS = 256, MAX_SCREEN_RECTS = 16 };
+
+        // one list is recorded while the other is drawn
+        DrawList mDrawLists[2];
+        unsigned int mRecordList;
+
+        // drawing frames on a separate thread
+        bool mThreaded;
+        SDL_Thread *mRenderThread;
+        SDL_mutex *mRenderMutex;
+        SDL_cond *mRenderCond;
+        DrawList *mPendingList; // handed over and not drawn yet
+        bool mQuitRender;
+        bool mRenderReady; // the thread has tried to take the context
+        bool mRenderContext; // and whether it got it
+        std::list<Job*> mRenderJobs; // work for the context, run before the next frame
+        unsigned int mJobsQueued;
+        unsigned int mJobsRun;
+        std::list<std::pair<unsigned int, Job*> > mReleaseJobs; // with the last frame that may use what they free
+        unsigned int mFramesHanded;
+        unsigned int mFramesDrawn;
+
+        // saves frames while recording a capture
+        RenderCapture *mCapture;
+
+        // frames composed from body parts, shared between beings
+        AvatarCache *mAvatarCache;
+        bool mLayeredAvatars;
+        enum { DEFAULT_AVATAR_BUDGET = 16 * 1024 * 1024 };
+
 		// list of textures
 		std::map<std::string, Texture*> mTextures;
 		typedef std::map<std::string, Texture*>::iterator TextureItr;
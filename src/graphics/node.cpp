@@ -82,6 +82,13 @@ namespace ST
 		mBounds.y = 0;
 		mBounds.width = mWidth;
 		mBounds.height = mHeight;
+
+		mHandle.layer = NULL;
+		mHandle.slot = -1;
+		mHandle.tileX = -1;
+		mHandle.tileY = -1;
+		mHandle.bucket = -1;
+		mHandle.bucketSlot = -1;
 	}
 
 	Node::~Node()
@@ -98,6 +105,9 @@ namespace ST
 	void Node::setVisible(bool visible)
 	{
 		mVisible = visible;
+
+		if (mHandle.layer)
+            graphicsEngine->markDirty(this);
 	}
 
 	const int Node::getHeight() const
@@ -139,8 +149,18 @@ namespace ST
 	{
 		// move to the new position
 		// update the bounds
+	    // where it was and where it will be both need drawing
+	    if (mHandle.layer)
+            graphicsEngine->markDirty(this);
+
 		mPosition.x = mBounds.x = position->x;
 		mPosition.y = mBounds.y = position->y;
+
+		if (mHandle.layer)
+		{
+            mHandle.layer->updateNode(this);
+            graphicsEngine->markDirty(this);
+		}
 	}
 
 	Texture* Node::getTexture()
@@ -219,6 +239,9 @@ namespace ST
             assert(mSetAnimation);
             mSetAnimation->nextFrame();
             mTimeSinceLastUpdate = 0;
+
+            if (mHandle.layer)
+                graphicsEngine->markDirty(this);
         }
     }
 }
@@ -53,6 +53,21 @@ namespace ST
 {
 	class Texture;
 	class Animation;
+	class Layer;
+
+	/**
+	 * Where a node is kept in its layer,
+	 * so it can be removed without searching for it
+	 */
+	struct NodeHandle
+	{
+	    Layer *layer;
+	    int slot; // position in the layer's list of nodes
+	    int tileX; // the tile the layer indexed it at, or -1
+	    int tileY;
+	    int bucket; // the part of the map it is drawn in
+	    int bucketSlot; // position in that bucket's list
+	};
 
 	class Node
 	{
@@ -134,7 +149,8 @@ namespace ST
 
 		/**
 		 * Move Node
-		 * Moves the node to a new position
+		 * Moves the node to a new position,
+		 * and tells its layer so it is drawn in the right place
 		 * @param position The new position for the node to be
 		 */
 		virtual void moveNode(Point *position);
@@ -145,6 +161,16 @@ namespace ST
 		 */
 		virtual Texture* getTexture();
 
+		/**
+		 * Get Texture Layers
+		 * Nodes drawn as several textures on top of each other
+		 * put them into textures, bottom first
+		 * @param textures Where to put the textures
+		 * @param max The most textures that fit
+		 * @return Returns how many there are, 0 to draw getTexture
+		 */
+		virtual unsigned int getTextureLayers(Texture **textures, unsigned int max) { return 0; }
+
 		/**
 		 * Toggle Name
 		 * Toggles whether the name of the node is shown
@@ -169,6 +195,12 @@ namespace ST
          */
         virtual void logic(int ms);
 
+        /**
+         * Get Layer Handle
+         * Returns where the node is kept in its layer, only used by Layer
+         */
+        NodeHandle& getLayerHandle() { return mHandle; }
+
 	protected:
 		std::string mName;
 		Texture *mTexture;
@@ -180,6 +212,7 @@ namespace ST
 		bool mVisible;
 		bool mShowName;
 		bool mBlocking;
+		NodeHandle mHandle;
 	};
 
 	class AnimatedNode : public Node
@@ -0,0 +1,140 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "nullgraphics.h"
+#include "texture.h"
+
+#include "../utilities/log.h"
+#include "../utilities/types.h"
+
+#include <SDL.h>
+#include <sstream>
+
+namespace ST
+{
+	NullGraphics::NullGraphics() : GraphicsEngine()
+	{
+		mOpenGL = 0;
+		mDrawCalls = 0;
+		mLastDrawCalls = 0;
+		mTotalDrawCalls = 0;
+		mBakeDrawCalls = 0;
+		mSceneCount = 0;
+		mBaking = false;
+	}
+
+	NullGraphics::~NullGraphics()
+	{
+	    stopRenderThread();
+
+	    std::stringstream str;
+	    str << "Null renderer drew " << mSceneCount << " frames with "
+            << mTotalDrawCalls << " draw calls, and "
+            << mBakeDrawCalls << " more baking static chunks";
+        logger->logDebug(str.str());
+	}
+
+	void NullGraphics::useDummyVideo()
+	{
+	    SDL_putenv((char*)"SDL_VIDEODRIVER=dummy");
+	}
+
+	bool NullGraphics::init(int fullscreen, int x, int y)
+	{
+	    mWidth = x;
+	    mHeight = y;
+
+	    // 32 bit so textures keep their alpha when converted to the display format
+	    mScreen = SDL_SetVideoMode(mWidth, mHeight, 32, SDL_SWSURFACE);
+
+        std::stringstream str;
+        str << "Using null renderer at " << mWidth << "x" << mHeight;
+        logger->logDebug(str.str());
+
+		return mScreen ? true : false;
+	}
+
+	void NullGraphics::drawRect(Rectangle &rect, bool filled)
+	{
+	    ++mDrawCalls;
+	}
+
+	void NullGraphics::drawTexturedRect(Rectangle &rect, Texture *texture)
+	{
+	    if (!texture)
+            return;
+
+	    // baking isnt part of the frame being drawn
+	    if (mBaking)
+	        ++mBakeDrawCalls;
+	    else
+	        ++mDrawCalls;
+	}
+
+	void NullGraphics::setupScene()
+	{
+	}
+
+	void NullGraphics::endScene()
+	{
+	    mLastDrawCalls = mDrawCalls;
+	    mTotalDrawCalls += mDrawCalls;
+	    mDrawCalls = 0;
+	    ++mSceneCount;
+	}
+
+	SDL_Surface* NullGraphics::createSurface(Texture *texture, int width, int height)
+	{
+		return NULL;
+	}
+
+	Texture* NullGraphics::bakeStaticChunk(const Rectangle &area)
+	{
+	    mBaking = true;
+	    drawStaticTiles(area);
+	    mBaking = false;
+
+	    return new Texture("static chunk", area.width, area.height);
+	}
+
+	void NullGraphics::drawStaticChunk(int x, int y, Texture *texture)
+	{
+	    ++mDrawCalls;
+	}
+}
@@ -0,0 +1,156 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * This expands the graphics class with a renderer that draws nothing,
+ * for running without a display
+ */
+
+#ifndef ST_NULLGRAPHICS_HEADER
+#define ST_NULLGRAPHICS_HEADER
+
+#include "graphics.h"
+
+namespace ST
+{
+	class Texture;
+
+	class NullGraphics : public GraphicsEngine
+	{
+	public:
+		/**
+		 * Constructor
+		 * Creates the renderer, should only be created once.
+		 * SDL must be using its dummy video driver,
+		 * see useDummyVideo
+		 */
+		NullGraphics();
+
+		/**
+		 * Destructor
+		 * Logs how much was drawn
+		 */
+		~NullGraphics();
+
+		/**
+		 * Use Dummy Video
+		 * Tells SDL not to open a window, call before creating the renderer
+		 */
+		static void useDummyVideo();
+
+		/**
+		 * Initialise the engine
+		 * Creates a screen surface in memory, so textures
+		 * are still created and composited as with SDL
+		 */
+		bool init(int fullscreen, int x, int y);
+
+		/**
+		 * Draw Untextured Rectangle
+		 * Only counts the draw call
+		 */
+		void drawRect(Rectangle &rect, bool filled);
+
+		/**
+		 * Draw Textured Rectangle
+		 * Only counts the draw call
+		 */
+		void drawTexturedRect(Rectangle &rect, Texture *texture);
+
+		/**
+		 * Setup the scene
+		 */
+		void setupScene();
+
+		/**
+		 * End Scene
+		 * Nothing is shown, the frame's draw calls are stored
+		 */
+		void endScene();
+
+		/**
+		 * Create Surface
+		 * Not supported, as there are no GL textures
+		 */
+		SDL_Surface* createSurface(Texture *texture, int width, int height);
+
+		/**
+		 * Get Draw Calls
+		 * Returns the number of draw calls in the last frame
+		 */
+		unsigned int getDrawCalls() const { return mLastDrawCalls; }
+
+		/**
+		 * Get Total Draw Calls
+		 * Returns the number of draw calls since the renderer was created
+		 */
+		unsigned long getTotalDrawCalls() const { return mTotalDrawCalls; }
+
+		/**
+		 * Get Bake Draw Calls
+		 * Returns the number of draw calls made baking static chunks,
+		 * these arent counted in the other totals
+		 */
+		unsigned long getBakeDrawCalls() const { return mBakeDrawCalls; }
+
+	protected:
+		/**
+		 * Bake Static Chunk
+		 * Goes through the static tiles like the other renderers,
+		 * but the chunk has no pixels. Its draw calls are counted apart
+		 */
+		Texture* bakeStaticChunk(const Rectangle &area);
+
+		/**
+		 * Draw Static Chunk
+		 * Only counts the draw call
+		 */
+		void drawStaticChunk(int x, int y, Texture *texture);
+
+	private:
+		unsigned int mDrawCalls;
+		unsigned int mLastDrawCalls;
+		unsigned long mTotalDrawCalls;
+		unsigned long mBakeDrawCalls;
+		unsigned long mSceneCount;
+		bool mBaking; // drawing a static chunk, not the frame
+	};
+}
+
+#endif
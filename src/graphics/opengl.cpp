@@ -39,8 +39,10 @@
 
 #include "opengl.h"
 #include "texture.h"
+#include "textureatlas.h"
 
 #include "../utilities/log.h"
+#include "../utilities/threadpool.h"
 #include "../utilities/types.h"
 
 #include <SDL.h>
@@ -49,15 +51,64 @@
 #include <agar/gui.h>
 #include <sstream>
 
+// SDL doesnt let the context move between threads, so it is done
+// with the platform's own calls. windows.h came with SDL_opengl.h
+#if defined __APPLE__
+#include <OpenGL/OpenGL.h>
+#elif !defined _WIN32
+#include <GL/glx.h>
+#endif
+
 namespace ST
 {
+	// reads a texture that isnt on the atlas back from GL
+	class ReadTextureJob : public Job
+	{
+	public:
+	    ReadTextureJob(Texture *texture, SDL_Surface *surface)
+            : texture(texture), surface(surface) {}
+
+	    void run()
+	    {
+	        glBindTexture(GL_TEXTURE_2D, texture->getGLTexture());
+	        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+	        glBindTexture(GL_TEXTURE_2D, 0);
+	    }
+
+	public:
+	    Texture *texture;
+	    SDL_Surface *surface;
+	};
+
+	class BakeChunkJob : public Job
+	{
+	public:
+	    BakeChunkJob(OpenGLGraphics *graphics, const Rectangle &area, GLuint *texture)
+            : graphics(graphics), area(area), texture(texture) {}
+
+	    void run()
+	    {
+	        *texture = graphics->copyStaticChunk(area);
+	    }
+
+	public:
+	    OpenGLGraphics *graphics;
+	    Rectangle area;
+	    GLuint *texture;
+	};
+
 	OpenGLGraphics::OpenGLGraphics() : GraphicsEngine()
 	{
 		mOpenGL = 1;
+		mSpriteTexture = 0;
+		mContext = NULL;
+		mDisplay = NULL;
+		mDrawable = 0;
 	}
 
 	OpenGLGraphics::~OpenGLGraphics()
 	{
+	    stopRenderThread();
 	}
 
 	bool OpenGLGraphics::init(int fullscreen, int x, int y)
@@ -81,6 +132,18 @@ namespace ST
         else
             mScreen = SDL_SetVideoMode(mWidth, mHeight, bpp, SDL_OPENGL);
 
+        // remember the context SDL made, for handing it to the render thread
+#if defined _WIN32
+        mDisplay = wglGetCurrentDC();
+        mContext = wglGetCurrentContext();
+#elif defined __APPLE__
+        mContext = CGLGetCurrentContext();
+#else
+        mDisplay = glXGetCurrentDisplay();
+        mDrawable = glXGetCurrentDrawable();
+        mContext = glXGetCurrentContext();
+#endif
+
 		std::stringstream str;
         str << "Using OpenGL renderer at " << mWidth << "x" << mHeight << "x" << bpp;
         logger->logDebug(str.str());
@@ -95,25 +158,16 @@ namespace ST
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		glDepthFunc(GL_LEQUAL);
 
-		mTile = glGenLists(1);
-		glNewList(mTile, GL_COMPILE);
-		glBegin(GL_TRIANGLE_STRIP);
-            glTexCoord2i(1, 1);
-            glVertex3f(1.0f, 1.0f, 0.0f);
-            glTexCoord2i(0, 1);
-            glVertex3f(0.0f, 1.0f, 0.0f);
-            glTexCoord2i(1, 0);
-            glVertex3f(1.0f, 0.0f, 0.0f);
-            glTexCoord2i(0, 0);
-            glVertex3f(0.0f, 0.0f, 0.0f);
-        glEnd();
-        glEndList();
+		// enough for a screen full of tiles before the batch grows
+		mSprites.reserve(4096);
 
 		return mScreen ? true : false;
 	}
 
 	void OpenGLGraphics::drawRect(Rectangle &rect, bool filled)
 	{
+	    flushSprites();
+
         glPushAttrib(GL_POLYGON_BIT|GL_LIGHTING_BIT|GL_DEPTH_BUFFER_BIT);
 		glPushMatrix();
 
@@ -162,42 +216,63 @@ namespace ST
 	    if (!texture)
             return;
 
-		// reset identity matrix
-		glLoadIdentity();
+        // the batch can only hold one texture at a time
+		GLuint tex = texture->getGLTexture();
+		if (tex != mSpriteTexture)
+		{
+		    flushSprites();
+		    mSpriteTexture = tex;
+		}
 
-		glPushAttrib(GL_POLYGON_BIT|GL_LIGHTING_BIT|GL_ENABLE_BIT|GL_DEPTH_BUFFER_BIT|GL_TEXTURE_BIT);
-		glPushMatrix();
+		// textures are drawn upwards from the rectangle's position
+		float left = (float)rect.x;
+		float top = (float)rect.y - rect.height;
+		float right = left + rect.width;
+		float bottom = (float)rect.y;
+
+		// textures on an atlas page only cover part of it
+		const GLfloat *coords = texture->getTexCoords();
+
+		SpriteVertex vertex;
+		vertex.x = left; vertex.y = top; vertex.u = coords[0]; vertex.v = coords[1];
+		mSprites.push_back(vertex);
+		vertex.x = right; vertex.u = coords[2];
+		mSprites.push_back(vertex);
+		vertex.y = bottom; vertex.v = coords[3];
+		mSprites.push_back(vertex);
+		vertex.x = left; vertex.u = coords[0];
+		mSprites.push_back(vertex);
+	}
 
-		// set position and size to local variables
-		float x = (float)rect.x;
-		float y = (float)rect.y - rect.height;
-		float width = (float)rect.width;
-		float height = (float)rect.height;
+	void OpenGLGraphics::flushSprites()
+	{
+	    if (mSprites.empty())
+            return;
 
-		// move to the correct position
-		glTranslatef(x, y, 0.0f);
-		glScalef(width, height, 1.0f);
+		glLoadIdentity();
+
+		glPushAttrib(GL_ENABLE_BIT|GL_TEXTURE_BIT|GL_CURRENT_BIT);
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
 
 		// enable transparancy
 		glEnable(GL_BLEND);
-
-		// disable depth testing
 		glDisable(GL_DEPTH_TEST);
 
-		// enable texture mapping
-		GLuint tex = texture->getGLTexture();
-		glBindTexture(GL_TEXTURE_2D, tex);
+		glBindTexture(GL_TEXTURE_2D, mSpriteTexture);
 		glEnable(GL_TEXTURE_2D);
 		glColor3f(1.0f, 1.0f, 1.0f);
 
-        glCallList(mTile);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glVertexPointer(2, GL_FLOAT, sizeof(SpriteVertex), &mSprites[0].x);
+		glTexCoordPointer(2, GL_FLOAT, sizeof(SpriteVertex), &mSprites[0].u);
 
-		glDisable(GL_TEXTURE_2D);
-		glDisable(GL_BLEND);
-		glEnable(GL_DEPTH_TEST);
+		glDrawArrays(GL_QUADS, 0, mSprites.size());
 
-		glPopMatrix();
+		glPopClientAttrib();
 		glPopAttrib();
+
+		mSprites.clear();
 	}
 
 	void OpenGLGraphics::setupScene()
@@ -208,13 +283,13 @@ namespace ST
 
 	void OpenGLGraphics::endScene()
 	{
+	    flushSprites();
         SDL_GL_SwapBuffers();
 	}
 
-	SDL_Surface* OpenGLGraphics::createSurface(unsigned int texture, int width, int height)
+	SDL_Surface* OpenGLGraphics::createSurface(Texture *texture, int width, int height)
 	{
 		SDL_Surface *surface = NULL;
-		glBindTexture(GL_TEXTURE_2D, texture);
 		surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
 #if AG_BYTEORDER == AG_BIG_ENDIAN
                                 0xff000000,
@@ -228,12 +303,126 @@ namespace ST
                                 0xff000000
 #endif
                                 );
-		if (surface)
+		if (!surface)
+            return NULL;
+
+		// copy from the atlas page rather than reading the whole page from GL
+		AtlasPage *page = texture->getAtlasPage();
+		if (page)
 		{
-			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+		    SDL_Rect srcRect;
+		    srcRect.x = texture->getAtlasX();
+		    srcRect.y = texture->getAtlasY();
+		    srcRect.w = width;
+		    srcRect.h = height;
+		    SDL_SetAlpha(page->surface, 0, 0);
+		    SDL_BlitSurface(page->surface, &srcRect, surface, NULL);
+		    return surface;
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
+
+		runOnRenderThread(new ReadTextureJob(texture, surface), true);
 
 		return surface;
 	}
+
+	Texture* OpenGLGraphics::bakeStaticChunk(const Rectangle &area)
+	{
+	    // the chunk is drawn in the top left of the back buffer, so must fit on screen
+	    if ((int)area.width > mWidth || (int)area.height > mHeight)
+            return NULL;
+
+        // the back buffer belongs to the render thread
+        GLuint tex = 0;
+        runOnRenderThread(new BakeChunkJob(this, area, &tex), true);
+
+        Texture *texture = new Texture("static chunk", area.width, area.height);
+        texture->setGLTexture(tex);
+
+        return texture;
+	}
+
+	GLuint OpenGLGraphics::copyStaticChunk(const Rectangle &area)
+	{
+        glMatrixMode(GL_MODELVIEW);
+        glPushAttrib(GL_COLOR_BUFFER_BIT);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        drawStaticTiles(area);
+        flushSprites();
+
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, area.width, area.height, 0,
+                     GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+        // gl puts the origin at the bottom left of the buffer
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, mHeight - area.height,
+                            area.width, area.height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // dont leave the chunk behind in the frame
+        glClear(GL_COLOR_BUFFER_BIT);
+        glPopAttrib();
+
+        return tex;
+	}
+
+	bool OpenGLGraphics::makeContextCurrent(bool current)
+	{
+	    if (!mContext)
+            return false;
+
+#if defined _WIN32
+        if (current)
+            return wglMakeCurrent((HDC)mDisplay, (HGLRC)mContext) != FALSE;
+        return wglMakeCurrent(NULL, NULL) != FALSE;
+#elif defined __APPLE__
+        CGLContextObj context = current ? (CGLContextObj)mContext : NULL;
+        return CGLSetCurrentContext(context) == kCGLNoError;
+#else
+        Display *display = (Display*)mDisplay;
+        if (current)
+            return glXMakeCurrent(display, (GLXDrawable)mDrawable, (GLXContext)mContext) == True;
+        return glXMakeCurrent(display, None, NULL) == True;
+#endif
+	}
+
+	void OpenGLGraphics::drawStaticChunk(int x, int y, Texture *texture)
+	{
+	    flushSprites();
+
+		glLoadIdentity();
+
+		glPushAttrib(GL_ENABLE_BIT|GL_TEXTURE_BIT);
+
+		float width = (float)texture->getWidth();
+		float height = (float)texture->getHeight();
+
+		// chunks are solid, so dont need blending
+		glDisable(GL_BLEND);
+		glDisable(GL_DEPTH_TEST);
+
+		glBindTexture(GL_TEXTURE_2D, texture->getGLTexture());
+		glEnable(GL_TEXTURE_2D);
+		glColor3f(1.0f, 1.0f, 1.0f);
+
+		glBegin(GL_TRIANGLE_STRIP);
+            glTexCoord2i(1, 0);
+            glVertex3f(x + width, y + height, 0.0f);
+            glTexCoord2i(0, 0);
+            glVertex3f(x, y + height, 0.0f);
+            glTexCoord2i(1, 1);
+            glVertex3f(x + width, y, 0.0f);
+            glTexCoord2i(0, 1);
+            glVertex3f(x, y, 0.0f);
+        glEnd();
+
+		glPopAttrib();
+	}
 }
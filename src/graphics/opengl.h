@@ -48,6 +48,8 @@
 
 #include <SDL_opengl.h>
 
+#include <vector>
+
 namespace ST
 {
 	class Texture;
@@ -55,7 +57,6 @@ namespace ST
 
 	class OpenGLGraphics : public GraphicsEngine
 	{
-	    GLuint mTile;
 	public:
 		/**
 		 * Constructor
@@ -81,6 +82,8 @@ namespace ST
 
 		/**
 		 * Draw Textured Rectangle
+		 * The quad is added to the sprite batch, which is only
+		 * drawn when the texture changes or the batch is flushed
 		 */
 		void drawTexturedRect(Rectangle &rect, Texture *texture);
 
@@ -97,7 +100,67 @@ namespace ST
 		/**
 		 * Create a SDL_Surface from a GL texture
 		 */
-		SDL_Surface* createSurface(unsigned int texture, int width, int height);
+		SDL_Surface* createSurface(Texture *texture, int width, int height);
+
+	protected:
+		/**
+		 * Bake Static Chunk
+		 * Draws the static tiles to the back buffer and copies them to a texture,
+		 * waiting for the render thread to do it
+		 */
+		Texture* bakeStaticChunk(const Rectangle &area);
+
+		/**
+		 * Make Context Current
+		 * Moves the context SDL made between the main and render threads
+		 */
+		bool makeContextCurrent(bool current);
+
+		/**
+		 * Draw Static Chunk
+		 * Chunks are copied from the back buffer upside down,
+		 * so they are drawn with flipped texture coordinates
+		 */
+		void drawStaticChunk(int x, int y, Texture *texture);
+
+		/**
+		 * Supports Layered Avatars
+		 * Body parts share atlas pages, so a crowd's parts batch together
+		 */
+		bool supportsLayeredAvatars() const { return true; }
+
+		/**
+		 * Flush Sprites
+		 * Draws the quads in the sprite batch with a single call
+		 */
+		void flushSprites();
+
+	private:
+		friend class BakeChunkJob;
+
+		/**
+		 * Copy Static Chunk
+		 * Does the drawing and copying for bakeStaticChunk on the render thread
+		 * @return Returns the GL texture holding the chunk
+		 */
+		GLuint copyStaticChunk(const Rectangle &area);
+
+		// a corner of a quad in the sprite batch
+		struct SpriteVertex
+		{
+			GLfloat x;
+			GLfloat y;
+			GLfloat u;
+			GLfloat v;
+		};
+		std::vector<SpriteVertex> mSprites;
+		GLuint mSpriteTexture; // texture used by every quad in the batch
+
+		// the context SDL made, kept as the platform's handles so
+		// the header doesnt need the window system's headers
+		void *mContext;
+		void *mDisplay; // the device context on Windows
+		unsigned long mDrawable;
 	};
 }
 
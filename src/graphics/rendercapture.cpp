@@ -0,0 +1,320 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "rendercapture.h"
+#include "graphics.h"
+#include "texture.h"
+
+#include "../utilities/log.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <sstream>
+
+namespace ST
+{
+    // first line of every capture, changed when the format changes
+	static const char *CAPTURE_HEADER = "STCAPTURE 2";
+
+	RenderCapture::RenderCapture()
+	{
+	    mFramesLeft = 0;
+	}
+
+	RenderCapture::~RenderCapture()
+	{
+	    if (mFile.is_open())
+            mFile.close();
+	}
+
+	bool RenderCapture::startRecording(const std::string &filename, unsigned int frames)
+	{
+	    mFile.open(filename.c_str(), std::ios::out | std::ios::trunc);
+	    if (!mFile.is_open())
+	    {
+	        logger->logError("Unable to create capture " + filename);
+	        return false;
+	    }
+
+	    mFile << CAPTURE_HEADER << "\n";
+	    mFramesLeft = frames;
+	    mTextureIds.clear();
+	    mPageIds.clear();
+
+	    return true;
+	}
+
+	bool RenderCapture::recordFrame(const DrawList &list)
+	{
+	    if (!mFile.is_open() || mFramesLeft == 0)
+            return false;
+
+        // textures used for the first time are saved before the frame
+        std::vector<unsigned int> ids(list.commands.size());
+        for (unsigned int i = 0; i < list.commands.size(); ++i)
+            ids[i] = getTextureId(list.commands[i].texture);
+
+        mFile << "frame " << list.partial << " " << list.screenRects.size()
+              << " " << list.commands.size() << "\n";
+
+        for (unsigned int i = 0; i < list.screenRects.size(); ++i)
+        {
+            const Rectangle &rect = list.screenRects[i];
+            mFile << rect.x << " " << rect.y << " "
+                  << rect.width << " " << rect.height << "\n";
+        }
+
+        for (unsigned int i = 0; i < list.commands.size(); ++i)
+        {
+            const DrawCommand &command = list.commands[i];
+            mFile << command.type << " " << ids[i] << " "
+                  << command.rect.x << " " << command.rect.y << " "
+                  << command.rect.width << " " << command.rect.height << "\n";
+        }
+
+        --mFramesLeft;
+        if (mFramesLeft == 0)
+        {
+            mFile.close();
+            return false;
+        }
+
+        return true;
+	}
+
+	unsigned int RenderCapture::getTextureId(Texture *texture)
+	{
+	    if (!texture)
+            return 0;
+
+        std::map<Texture*, unsigned int>::iterator itr;
+        itr = mTextureIds.find(texture);
+        if (itr != mTextureIds.end())
+            return itr->second;
+
+        // pages are numbered in the order they are first seen
+        int page = -1;
+        if (texture->getAtlasPage())
+        {
+            std::map<AtlasPage*, int>::iterator pageItr = mPageIds.find(texture->getAtlasPage());
+            if (pageItr == mPageIds.end())
+                pageItr = mPageIds.insert(std::make_pair(texture->getAtlasPage(), (int)mPageIds.size())).first;
+            page = pageItr->second;
+        }
+
+        // names go last, as they can have spaces
+        unsigned int id = mTextureIds.size() + 1;
+        mTextureIds[texture] = id;
+        mFile << "texture " << id << " " << texture->getWidth() << " "
+              << texture->getHeight() << " " << page << " " << texture->getName() << "\n";
+
+        return id;
+	}
+
+	bool RenderCapture::load(const std::string &filename)
+	{
+	    std::ifstream file(filename.c_str());
+	    std::string line;
+	    if (!std::getline(file, line) || line != CAPTURE_HEADER)
+	    {
+	        logger->logError("Not a valid capture " + filename);
+	        return false;
+	    }
+
+        mFrames.clear();
+        std::vector<TextureInfo> textures;
+
+        // the ids are read first, the textures are only made
+        // once they are all known so each page is made in one go
+        std::vector<std::vector<unsigned int> > ids;
+
+        bool valid = true;
+        std::string type;
+        while (valid && file >> type)
+        {
+            if (type == "texture")
+            {
+                TextureInfo info;
+                file >> info.id >> info.width >> info.height >> info.page;
+                std::getline(file >> std::ws, info.name);
+                textures.push_back(info);
+            }
+            else if (type == "frame")
+            {
+                DrawList list;
+                unsigned int rects, commands;
+                file >> list.partial >> rects >> commands;
+
+                list.screenRects.resize(rects);
+                for (unsigned int i = 0; i < rects; ++i)
+                {
+                    Rectangle &rect = list.screenRects[i];
+                    file >> rect.x >> rect.y >> rect.width >> rect.height;
+                }
+
+                list.commands.resize(commands);
+                ids.push_back(std::vector<unsigned int>(commands));
+                for (unsigned int i = 0; i < commands; ++i)
+                {
+                    DrawCommand &command = list.commands[i];
+                    int commandType;
+                    file >> commandType >> ids.back()[i] >> command.rect.x >> command.rect.y
+                         >> command.rect.width >> command.rect.height;
+                    command.type = (DrawCommand::Type)commandType;
+                    command.texture = NULL;
+                }
+
+                mFrames.push_back(list);
+            }
+            else
+            {
+                valid = false;
+            }
+
+            if (!file)
+                valid = false;
+        }
+
+        if (!valid)
+        {
+            logger->logError("Error reading capture " + filename);
+            mFrames.clear();
+            return false;
+        }
+
+        std::map<unsigned int, Texture*> loaded;
+        loadTextures(textures, loaded);
+        loaded[0] = NULL;
+
+        for (unsigned int frame = 0; frame < mFrames.size(); ++frame)
+        {
+            std::vector<DrawCommand> &commands = mFrames[frame].commands;
+            for (unsigned int i = 0; i < commands.size(); ++i)
+                commands[i].texture = loaded[ids[frame][i]];
+        }
+
+        std::stringstream str;
+        str << "Loaded capture with " << mFrames.size() << " frames";
+        logger->logDebug(str.str());
+
+        return true;
+	}
+
+	void RenderCapture::loadTextures(std::vector<TextureInfo> &textures,
+	                                 std::map<unsigned int, Texture*> &loaded)
+	{
+	    // textures that shared a page are made one after another,
+	    // starting a new page for each so they dont spread over two
+	    std::stable_sort(textures.begin(), textures.end(), comparePages);
+
+	    std::map<std::string, unsigned int> names;
+	    for (unsigned int i = 0; i < textures.size(); ++i)
+            ++names[textures[i].name];
+
+	    int lastPage = -1;
+	    for (unsigned int i = 0; i < textures.size(); ++i)
+	    {
+	        const TextureInfo &info = textures[i];
+	        if (info.page != lastPage && info.page >= 0)
+                graphicsEngine->startAtlasPage();
+	        lastPage = info.page;
+
+	        loaded[info.id] = findTexture(info, info.page >= 0, names[info.name] > 1);
+	    }
+	}
+
+	bool RenderCapture::comparePages(const TextureInfo &first, const TextureInfo &second)
+	{
+	    return first.page < second.page;
+	}
+
+	Texture* RenderCapture::findTexture(const TextureInfo &info, bool atlas, bool sharedName)
+	{
+	    // names such as static chunks and avatar frames are used by many
+	    // textures, finding those by name would draw them all the same
+	    Texture *texture = NULL;
+	    if (!sharedName)
+	    {
+	        texture = graphicsEngine->getTexture(info.name);
+	        if (texture)
+                return texture;
+	    }
+
+        int width = info.width;
+        int height = info.height;
+        if (width <= 0 || height <= 0)
+            return NULL;
+
+        // the stand in is named by its id and size, so replaying
+        // the capture again uses the ones already made
+        std::stringstream name;
+        name << "capture" << info.id << " " << width << "x" << height << " " << info.name;
+        texture = graphicsEngine->getTexture(name.str());
+        if (texture)
+            return texture;
+
+		// Set the byte order of RGBA
+		Uint32 rmask, gmask, bmask, amask;
+		#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		rmask = 0xff000000;
+		gmask = 0x00ff0000;
+		bmask = 0x0000ff00;
+		amask = 0x000000ff;
+		#else
+		rmask = 0x000000ff;
+		gmask = 0x0000ff00;
+		bmask = 0x00ff0000;
+		amask = 0xff000000;
+		#endif
+
+        // the pixels arent saved, so draw the same size in plain grey
+        SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+            32, rmask, gmask, bmask, amask);
+        if (!surface)
+            return NULL;
+
+        SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 128, 128, 128, 255));
+
+        // the engine keeps the texture by name, so its freed with the others
+        texture = graphicsEngine->createTexture(surface, name.str(), 0, 0, width, height, atlas);
+        SDL_FreeSurface(surface);
+
+        return texture;
+	}
+}
@@ -0,0 +1,158 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The Render Capture class saves the frames drawn to a file,
+ * and loads them again so they can be replayed
+ */
+
+#ifndef ST_RENDERCAPTURE_HEADER
+#define ST_RENDERCAPTURE_HEADER
+
+#include "drawlist.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ST
+{
+	class Texture;
+	struct AtlasPage;
+
+	class RenderCapture
+	{
+	public:
+		RenderCapture();
+		~RenderCapture();
+
+		/**
+		 * Start Recording
+		 * Opens the file to save the next frames to
+		 * @param filename The file to create
+		 * @param frames The number of frames to save
+		 * @return Returns false if the file couldnt be created
+		 */
+		bool startRecording(const std::string &filename, unsigned int frames);
+
+		/**
+		 * Record Frame
+		 * Saves each command in the list, with the size, atlas page
+		 * and name of its texture the first time its used
+		 * @return Returns false once enough frames are saved
+		 */
+		bool recordFrame(const DrawList &list);
+
+		/**
+		 * Load
+		 * Reads the frames from a capture, textures with a name no other
+		 * texture in it had are found by name, the rest are replaced by
+		 * a plain one the same size for each texture captured.
+		 * The stand ins are packed into the atlas with the same
+		 * textures sharing a page as when it was captured
+		 * @param filename The file to read
+		 * @return Returns false if the file isnt a valid capture
+		 */
+		bool load(const std::string &filename);
+
+		/**
+		 * Get Frame Count
+		 * Returns the number of frames loaded
+		 */
+		unsigned int getFrameCount() const { return mFrames.size(); }
+
+		/**
+		 * Get Frame
+		 * Returns a loaded frame, ready to draw
+		 */
+		DrawList& getFrame(unsigned int frame) { return mFrames[frame]; }
+
+	private:
+		struct TextureInfo
+		{
+		    unsigned int id;
+		    int width;
+		    int height;
+		    int page; // atlas page it was on, -1 if it wasnt
+		    std::string name;
+		};
+
+		/**
+		 * Get Texture Id
+		 * Returns the id saved for the texture, saving its details
+		 * the first time the texture is seen
+		 */
+		unsigned int getTextureId(Texture *texture);
+
+		/**
+		 * Load Textures
+		 * Finds or creates the textures of a loaded capture,
+		 * a page at a time so the stand ins share pages the same way
+		 * @param textures The textures read, by id
+		 * @param loaded Filled with the texture to use for each id
+		 */
+		void loadTextures(std::vector<TextureInfo> &textures,
+		                  std::map<unsigned int, Texture*> &loaded);
+
+		/**
+		 * Find Texture
+		 * Gets a loaded texture by name, or the stand in for the id
+		 * creating it the first time
+		 * @param atlas Whether to pack the stand in into the atlas
+		 * @param sharedName Whether other textures in the capture had the
+		 *                   same name, so it cant be found by name
+		 */
+		Texture* findTexture(const TextureInfo &info, bool atlas, bool sharedName);
+
+		static bool comparePages(const TextureInfo &first, const TextureInfo &second);
+
+	private:
+		std::ofstream mFile;
+		unsigned int mFramesLeft;
+
+		// textures are saved by pointer as many share a name, 0 is no texture
+		std::map<Texture*, unsigned int> mTextureIds;
+		std::map<AtlasPage*, int> mPageIds;
+
+		std::vector<DrawList> mFrames;
+	};
+}
+
+#endif
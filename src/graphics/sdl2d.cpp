@@ -55,6 +55,7 @@ namespace ST
 
 	SDLGraphics::~SDLGraphics()
 	{
+	    stopRenderThread();
 	}
 
 	bool SDLGraphics::init(int fullscreen, int x, int y)
@@ -67,8 +68,13 @@ namespace ST
 		const SDL_VideoInfo* video = SDL_GetVideoInfo();
 		int bpp = video->vfmt->BitsPerPixel;
 
-        // set fullscreen
+        // drawing only what changed needs the last frame to stay on screen,
+        // so cant use double buffering
         int flags = SDL_HWSURFACE|SDL_DOUBLEBUF;
+        if (getDirtyRects())
+            flags = SDL_SWSURFACE;
+
+        // set fullscreen
         if (fullscreen)
             flags |= SDL_FULLSCREEN;
 
@@ -99,7 +105,8 @@ namespace ST
 		srcRect.y = 0;
 		srcRect.w = texture->getWidth();
 		srcRect.h = texture->getHeight();
-		SDL_SetAlpha(texture->getSDLSurface(), SDL_SRCALPHA | SDL_RLEACCEL, 0);
+
+		// the surface was put in the display format when it was created
 		SDL_BlitSurface(texture->getSDLSurface(), &srcRect, mScreen, &dstRect);
 	}
 
@@ -113,9 +120,78 @@ namespace ST
 		SDL_Flip(mScreen);
 	}
 
-	SDL_Surface* SDLGraphics::createSurface(unsigned int texture, int width, int height)
+	SDL_Surface* SDLGraphics::createSurface(Texture *texture, int width, int height)
 	{
 		// This is not supported by SDL
 		return NULL;
 	}
+
+	Texture* SDLGraphics::bakeStaticChunk(const Rectangle &area)
+	{
+	    // same format as the screen, so drawing the chunk is a plain copy
+	    SDL_PixelFormat *format = mScreen->format;
+	    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, area.width, area.height,
+                                    format->BitsPerPixel, format->Rmask, format->Gmask,
+                                    format->Bmask, 0);
+        if (!surface)
+            return NULL;
+
+        // filled with the same colour setupScene clears to
+        SDL_FillRect(surface, NULL, 0);
+
+        // draw the tiles into the chunk instead of the screen
+        SDL_Surface *screen = mScreen;
+        mScreen = surface;
+        drawStaticTiles(area);
+        mScreen = screen;
+
+        Texture *texture = new Texture("static chunk", area.width, area.height);
+        texture->setImage(surface);
+
+        return texture;
+	}
+
+	void SDLGraphics::drawStaticChunk(int x, int y, Texture *texture)
+	{
+		SDL_Rect dstRect;
+		dstRect.x = x;
+		dstRect.y = y;
+		dstRect.w = 0; // not used
+		dstRect.h = 0; // not used
+		SDL_BlitSurface(texture->getSDLSurface(), NULL, mScreen, &dstRect);
+	}
+
+	bool SDLGraphics::supportsDirtyRects() const
+	{
+	    return mScreen && !(mScreen->flags & SDL_DOUBLEBUF);
+	}
+
+	void SDLGraphics::setClipArea(const Rectangle *area)
+	{
+	    if (!area)
+	    {
+	        SDL_SetClipRect(mScreen, NULL);
+	        return;
+	    }
+
+	    SDL_Rect rect;
+	    rect.x = area->x;
+	    rect.y = area->y;
+	    rect.w = area->width;
+	    rect.h = area->height;
+	    SDL_SetClipRect(mScreen, &rect);
+	}
+
+	void SDLGraphics::updateRects(const std::vector<Rectangle> &rects)
+	{
+	    mUpdateRects.resize(rects.size());
+	    for (unsigned int i = 0; i < rects.size(); ++i)
+	    {
+	        mUpdateRects[i].x = rects[i].x;
+	        mUpdateRects[i].y = rects[i].y;
+	        mUpdateRects[i].w = rects[i].width;
+	        mUpdateRects[i].h = rects[i].height;
+	    }
+	    SDL_UpdateRects(mScreen, mUpdateRects.size(), &mUpdateRects[0]);
+	}
 }
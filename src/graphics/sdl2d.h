@@ -46,6 +46,9 @@
 
 #include "graphics.h"
 
+#include <SDL.h>
+#include <vector>
+
 namespace ST
 {
 	class Texture;
@@ -94,7 +97,42 @@ namespace ST
 		/**
 		 * Create a SDL_Surface from a GL texture
 		 */
-		SDL_Surface* createSurface(unsigned int texture, int width, int height);
+		SDL_Surface* createSurface(Texture *texture, int width, int height);
+
+	protected:
+		/**
+		 * Bake Static Chunk
+		 * Blits the static tiles into a surface in the screen's format
+		 */
+		Texture* bakeStaticChunk(const Rectangle &area);
+
+		/**
+		 * Draw Static Chunk
+		 * Copies the chunk to the screen without any blending
+		 */
+		void drawStaticChunk(int x, int y, Texture *texture);
+
+		/**
+		 * Supports Dirty Rects
+		 * Only when the screen isnt double buffered, as a flip
+		 * would show a buffer missing the last frame's changes
+		 */
+		bool supportsDirtyRects() const;
+
+		/**
+		 * Set Clip Area
+		 * Sets the clip rectangle of the screen
+		 */
+		void setClipArea(const Rectangle *area);
+
+		/**
+		 * Update Rects
+		 * Copies the rects to the display with SDL_UpdateRects
+		 */
+		void updateRects(const std::vector<Rectangle> &rects);
+
+	private:
+		std::vector<SDL_Rect> mUpdateRects; // kept to save allocating each frame
 	};
 }
 
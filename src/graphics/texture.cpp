@@ -38,15 +38,127 @@
  ********************************************/
 
 #include "texture.h"
+#include "graphics.h"
+#include "textureatlas.h"
+
+#include "../utilities/threadpool.h"
 
 #include <SDL.h>
+#include <cstring>
 
 namespace ST
 {
-	Texture::Texture(std::string name) : mName(name), mInstances(1), mGLTexture(0), mSurface(0)
+	// puts the pixels into a new GL texture on the render thread
+	class UploadTextureJob : public Job
+	{
+	public:
+	    UploadTextureJob(GLuint *texture, SDL_Surface *source) : texture(texture)
+	    {
+	        // the caller frees its surface straight after, so the job keeps a copy
+	        SDL_PixelFormat *format = source->format;
+	        surface = SDL_CreateRGBSurface(SDL_SWSURFACE, source->w, source->h,
+                                           format->BitsPerPixel, format->Rmask,
+                                           format->Gmask, format->Bmask, format->Amask);
+	        if (!surface)
+                return;
+
+	        SDL_LockSurface(source);
+	        for (int row = 0; row < source->h; ++row)
+	        {
+	            memcpy((Uint8*)surface->pixels + row * surface->pitch,
+                       (Uint8*)source->pixels + row * source->pitch,
+                       source->w * format->BytesPerPixel);
+	        }
+	        SDL_UnlockSurface(source);
+	    }
+
+	    ~UploadTextureJob()
+	    {
+	        if (surface)
+                SDL_FreeSurface(surface);
+	    }
+
+	    void run()
+	    {
+	        if (!surface)
+                return;
+
+            int mode = GL_RGBA;
+
+            // set mode based on bpp
+            if (surface->format->BytesPerPixel == 3)
+            {
+                mode = GL_RGB;
+            }
+
+            // Generate 1 texture
+            GLuint tex;
+            glGenTextures(1, &tex);
+
+            // Bind the texture first
+            glBindTexture(GL_TEXTURE_2D, tex);
+
+            // Put the SDL pixels into the texture
+            SDL_LockSurface(surface);
+            gluBuild2DMipmaps(GL_TEXTURE_2D, mode, surface->w, surface->h,
+                       mode, GL_UNSIGNED_BYTE, surface->pixels );
+            SDL_UnlockSurface(surface);
+
+            // Set params for filter to make the image look nice
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+            *texture = tex;
+	    }
+
+	public:
+	    GLuint *texture; // outlives the Texture until released
+	    SDL_Surface *surface;
+	};
+
+	// uploads are queued before it, so the name is filled in by the time it runs
+	class DeleteGLTextureJob : public Job
+	{
+	public:
+	    DeleteGLTextureJob(GLuint *texture) : texture(texture) {}
+
+	    void run()
+	    {
+	        if (*texture)
+                glDeleteTextures(1, texture);
+	        delete texture;
+	    }
+
+	public:
+	    GLuint *texture;
+	};
+
+	// deletes a texture once no frame handed over can draw it
+	class DeleteTextureJob : public Job
+	{
+	public:
+	    DeleteTextureJob(Texture *texture) : texture(texture) {}
+
+	    void run()
+	    {
+	        delete texture;
+	    }
+
+	public:
+	    Texture *texture;
+	};
+
+	Texture::Texture(std::string name) : mName(name), mInstances(1), mGLTexture(new GLuint(0)), mSurface(0),
+		mDecodedSurface(0), mAtlasPage(0), mAtlasX(0), mAtlasY(0)
 	{
 		mWidth = 0;
 		mHeight = 0;
+		mTexCoords[0] = 0.0f;
+		mTexCoords[1] = 0.0f;
+		mTexCoords[2] = 1.0f;
+		mTexCoords[3] = 1.0f;
 	}
 
 	Texture::Texture(std::string name, int width, int height)
@@ -54,9 +166,17 @@ namespace ST
 		mInstances(1),
 		mWidth(width),
 		mHeight(height),
-		mGLTexture(0),
-		mSurface(0)
+		mGLTexture(new GLuint(0)),
+		mSurface(0),
+		mDecodedSurface(0),
+		mAtlasPage(0),
+		mAtlasX(0),
+		mAtlasY(0)
 	{
+		mTexCoords[0] = 0.0f;
+		mTexCoords[1] = 0.0f;
+		mTexCoords[2] = 1.0f;
+		mTexCoords[3] = 1.0f;
 	}
 
 	Texture::~Texture()
@@ -66,59 +186,66 @@ namespace ST
 			SDL_FreeSurface(mSurface);
 			mSurface = 0;
 		}
-		if (mGLTexture)
+		if (mDecodedSurface)
 		{
-			glDeleteTextures(1, &mGLTexture);
-			mGLTexture = 0;
+			SDL_FreeSurface(mDecodedSurface);
+			mDecodedSurface = 0;
 		}
-	}
-
-	void Texture::setPixels(SDL_Surface *surface)
-	{
-		int mode = GL_RGBA;
 
-		// set mode based on bpp
-		if (surface->format->BytesPerPixel == 3)
+		// only the render thread can use the context, atlas
+		// pages are shared so are freed by the atlas
+		Job *job = new DeleteGLTextureJob(mGLTexture);
+		if (graphicsEngine)
 		{
-			mode = GL_RGB;
+			graphicsEngine->runOnRenderThread(job);
 		}
+		else
+		{
+			job->run();
+			delete job;
+		}
+	}
 
+	void Texture::setPixels(SDL_Surface *surface)
+	{
 		// Set the width and height of the texture
 		mWidth = surface->w;
 		mHeight = surface->h;
 
-		// Generate 1 texture
-		glGenTextures(1, &mGLTexture);
-
-		// Bind the texture first
-		glBindTexture(GL_TEXTURE_2D, mGLTexture);
-
-		// test
-		//glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-
-		// Put the SDL pixels into the texture
-		SDL_LockSurface(surface);
-		gluBuild2DMipmaps(GL_TEXTURE_2D, mode, mWidth, mHeight,
-                   mode, GL_UNSIGNED_BYTE, surface->pixels );
-		SDL_UnlockSurface(surface);
-
-        // Set params for filter to make the image look nice
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		// the GL texture is made on the render thread,
+		// before it draws the next frame
+		graphicsEngine->runOnRenderThread(new UploadTextureJob(mGLTexture, surface));
 	}
 
 	void Texture::setImage(SDL_Surface *surface)
 	{
 		mSurface = surface;
+		if (mDecodedSurface)
+		{
+			SDL_FreeSurface(mDecodedSurface);
+			mDecodedSurface = 0;
+		}
 	}
 
 	void Texture::setGLTexture(unsigned int texture)
 	{
-	    mGLTexture = texture;
+	    *mGLTexture = texture;
 	}
 
+	void Texture::setAtlasPage(AtlasPage *page, int x, int y)
+	{
+	    mAtlasPage = page;
+	    mAtlasX = x;
+	    mAtlasY = y;
+
+	    float w = (float)page->surface->w;
+	    float h = (float)page->surface->h;
+	    mTexCoords[0] = x / w;
+	    mTexCoords[1] = y / h;
+	    mTexCoords[2] = (x + mWidth) / w;
+	    mTexCoords[3] = (y + mHeight) / h;
+	}
+
 	void Texture::setSize(unsigned int w, unsigned int h)
 	{
 	    mWidth = w;
@@ -142,7 +269,10 @@ namespace ST
 
 	GLuint Texture::getGLTexture()
 	{
-		return mGLTexture;
+		// the page's texture is made on the render thread after it is placed
+		if (mAtlasPage)
+			return mAtlasPage->texture;
+		return *mGLTexture;
 	}
 
 	SDL_Surface* Texture::getSDLSurface()
@@ -150,12 +280,47 @@ namespace ST
 		return mSurface;
 	}
 
+	SDL_Surface* Texture::getDecodedSurface()
+	{
+		if (mDecodedSurface || !mSurface)
+			return mDecodedSurface;
+
+		// only surfaces that may be run length encoded need decoding
+		if (!(mSurface->flags & (SDL_RLEACCEL | SDL_RLEACCELOK)))
+			return mSurface;
+
+		// locking decodes the surface, which the render thread mustnt be blitting
+		if (graphicsEngine)
+			graphicsEngine->finishFrame();
+
+		SDL_PixelFormat *format = mSurface->format;
+		mDecodedSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, mSurface->w, mSurface->h,
+			format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+		if (!mDecodedSurface)
+			return NULL;
+
+		SDL_LockSurface(mSurface);
+		for (int row = 0; row < mSurface->h; ++row)
+		{
+			memcpy((Uint8*)mDecodedSurface->pixels + row * mDecodedSurface->pitch,
+				   (Uint8*)mSurface->pixels + row * mSurface->pitch,
+				   mSurface->w * format->BytesPerPixel);
+		}
+		SDL_UnlockSurface(mSurface);
+
+		return mDecodedSurface;
+	}
+
 	void Texture::remove()
 	{
 		--mInstances;
 		if (mInstances <= 0)
 		{
-			delete this;
+			// the frame being drawn may still use it
+			if (graphicsEngine)
+				graphicsEngine->releaseAfterFrame(new DeleteTextureJob(this));
+			else
+				delete this;
 		}
 	}
 }
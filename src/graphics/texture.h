@@ -51,6 +51,8 @@ struct SDL_Surface;
 
 namespace ST
 {
+	struct AtlasPage;
+
 	class Texture
 	{
 	public:
@@ -62,12 +64,15 @@ namespace ST
 
 		/**
 		 * Destructor
+		 * Only delete textures no frame handed to the render
+		 * thread can draw, remove waits for them
 		 */
 		~Texture();
 
 		/**
 		 * Set Pixels
-		 * Puts a SDL Surface's pixels into a GL Texture
+		 * Puts a SDL Surface's pixels into a GL Texture,
+		 * which is made on the render thread
 		 */
 		void setPixels(SDL_Surface *surface);
 
@@ -82,6 +87,16 @@ namespace ST
 		 * When we already have a created texture
 		 */
         void setGLTexture(unsigned int texture);
+
+		/**
+		 * Set Atlas Page
+		 * Points the texture at an area of an atlas page,
+		 * the page keeps ownership of the GL texture
+		 * @param page The page holding the pixels
+		 * @param x The left of the area on the page
+		 * @param y The top of the area on the page
+		 */
+		void setAtlasPage(AtlasPage *page, int x, int y);
 
         /**
          * Set Size
@@ -94,6 +109,12 @@ namespace ST
 		 */
 		void increaseCount() { ++mInstances; }
 
+		/**
+		 * Get instance count
+		 * Returns how many things are holding the texture
+		 */
+		int getCount() const { return mInstances; }
+
 		/**
 		 * Get Name
 		 * @return Returns the name of the texture
@@ -114,20 +135,57 @@ namespace ST
 
 		/**
 		 * Get GL Texture
+		 * Textures are made on the render thread, so call
+		 * GraphicsEngine::finishFrame first from any other thread
 		 * @return Returns the GL Texture
 		 */
 		GLuint getGLTexture();
 
+		/**
+		 * Get Texture Coordinates
+		 * @return Returns the left, top, right and bottom of the
+		 * texture inside its GL texture
+		 */
+		const GLfloat* getTexCoords() const { return mTexCoords; }
+
+		/**
+		 * Get Atlas Page
+		 * @return Returns the page the texture is on, or NULL if it
+		 * has its own GL texture
+		 */
+		AtlasPage* getAtlasPage() const { return mAtlasPage; }
+
+		/**
+		 * Get Atlas X
+		 * @return Returns the left of the texture on its page
+		 */
+		int getAtlasX() const { return mAtlasX; }
+
+		/**
+		 * Get Atlas Y
+		 * @return Returns the top of the texture on its page
+		 */
+		int getAtlasY() const { return mAtlasY; }
+
 		/**
 		 * Get SDL Surface
 		 * @return Returns the SDL Surface
 		 */
 		SDL_Surface* getSDLSurface();
 
+		/**
+		 * Get Decoded Surface
+		 * Returns the SDL Surface's pixels without run length encoding,
+		 * decoded into a copy kept with the texture the first time
+		 * @return Returns NULL if there is no SDL Surface
+		 */
+		SDL_Surface* getDecodedSurface();
+
 		/**
 		 * Remove
 		 * This will eventually delete the texture
-		 * when the number of instances equals 0
+		 * when the number of instances equals 0, once
+		 * the frames handed over are drawn
 		 */
 		void remove();
 
@@ -136,8 +194,13 @@ namespace ST
 		int mInstances;
 		int mWidth;
 		int mHeight;
-		GLuint mGLTexture;
+		GLuint *mGLTexture; // kept apart so a queued upload or release can outlive the texture
 		SDL_Surface *mSurface;
+		SDL_Surface *mDecodedSurface; // mSurface without run length encoding
+		AtlasPage *mAtlasPage;
+		int mAtlasX;
+		int mAtlasY;
+		GLfloat mTexCoords[4];
 	};
 }
 
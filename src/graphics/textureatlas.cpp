@@ -0,0 +1,269 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "textureatlas.h"
+#include "graphics.h"
+#include "texture.h"
+
+#include "../utilities/log.h"
+#include "../utilities/threadpool.h"
+
+#include <SDL.h>
+#include <cstring>
+
+namespace ST
+{
+	// the GL side of the atlas is done on the render thread, the pages
+	// are filled in before the jobs are queued and not changed after
+
+	class MaxTextureSizeJob : public Job
+	{
+	public:
+	    MaxTextureSizeJob(GLint *size) : size(size) {}
+
+	    void run()
+	    {
+	        glGetIntegerv(GL_MAX_TEXTURE_SIZE, size);
+	    }
+
+	public:
+	    GLint *size;
+	};
+
+	class CreatePageJob : public Job
+	{
+	public:
+	    CreatePageJob(AtlasPage *page, int size) : page(page), size(size) {}
+
+	    void run()
+	    {
+	        // the page surface may be being filled, so a cleared copy is
+	        // uploaded and the textures on it follow in their own jobs
+	        std::vector<unsigned char> pixels(size * size * 4, 0);
+
+	        glGenTextures(1, &page->texture);
+	        glBindTexture(GL_TEXTURE_2D, page->texture);
+	        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	        // textures are drawn at their own size, so nearest is exact
+	        // and cant pick up pixels from a neighbour
+	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	        glBindTexture(GL_TEXTURE_2D, 0);
+	    }
+
+	public:
+	    AtlasPage *page;
+	    int size;
+	};
+
+	class UploadAreaJob : public Job
+	{
+	public:
+	    UploadAreaJob(AtlasPage *page, int x, int y, int w, int h)
+            : page(page), x(x), y(y), w(w), h(h) {}
+
+	    void run()
+	    {
+	        // page surfaces are software surfaces, so dont need locking
+	        SDL_Surface *surface = page->surface;
+	        glBindTexture(GL_TEXTURE_2D, page->texture);
+	        glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch / 4);
+	        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                            (Uint8*)surface->pixels + y * surface->pitch + x * 4);
+	        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	        glBindTexture(GL_TEXTURE_2D, 0);
+	    }
+
+	public:
+	    AtlasPage *page;
+	    int x;
+	    int y;
+	    int w;
+	    int h;
+	};
+
+	class DeletePagesJob : public Job
+	{
+	public:
+	    void run()
+	    {
+	        if (!textures.empty())
+                glDeleteTextures(textures.size(), &textures[0]);
+	    }
+
+	public:
+	    std::vector<GLuint> textures;
+	};
+
+	TextureAtlas::TextureAtlas()
+	{
+	    // large pages mean fewer texture changes, but older cards cant take them
+	    GLint maxSize = 0;
+	    graphicsEngine->runOnRenderThread(new MaxTextureSizeJob(&maxSize), true);
+	    mPageSize = 2048;
+	    if (maxSize > 0 && maxSize < mPageSize)
+            mPageSize = maxSize;
+	    mStartPage = false;
+	}
+
+	TextureAtlas::~TextureAtlas()
+	{
+	    // uploads still queued read the page surfaces
+	    graphicsEngine->finishFrame();
+
+	    DeletePagesJob *job = new DeletePagesJob;
+	    for (unsigned int i = 0; i < mPages.size(); ++i)
+	    {
+	        job->textures.push_back(mPages[i]->texture);
+	        SDL_FreeSurface(mPages[i]->surface);
+	        delete mPages[i];
+	    }
+	    mPages.clear();
+	    graphicsEngine->runOnRenderThread(job);
+	}
+
+	bool TextureAtlas::addTexture(Texture *texture, SDL_Surface *surface)
+	{
+	    if (surface->format->BytesPerPixel != 4 ||
+            surface->w > mPageSize || surface->h > mPageSize)
+        {
+            return false;
+        }
+
+        // only the last page has room, the others were filled before it
+        AtlasPage *page = mPages.empty() || mStartPage ? NULL : mPages.back();
+        int x, y;
+        if (!page || !place(page, surface->w, surface->h, x, y))
+        {
+            page = createPage();
+            if (!page || !place(page, surface->w, surface->h, x, y))
+                return false;
+        }
+
+        // keep a copy for reading back, rows are copied as the formats match
+        SDL_LockSurface(surface);
+        SDL_LockSurface(page->surface);
+        for (int row = 0; row < surface->h; ++row)
+        {
+            memcpy((Uint8*)page->surface->pixels + (y + row) * page->surface->pitch + x * 4,
+                   (Uint8*)surface->pixels + row * surface->pitch, surface->w * 4);
+        }
+        SDL_UnlockSurface(page->surface);
+        SDL_UnlockSurface(surface);
+
+        // the area is uploaded from the copy, so the surface can be freed
+        graphicsEngine->runOnRenderThread(new UploadAreaJob(page, x, y, surface->w, surface->h));
+
+        texture->setAtlasPage(page, x, y);
+        mStartPage = false;
+
+        return true;
+	}
+
+	void TextureAtlas::startPage()
+	{
+	    mStartPage = true;
+	}
+
+	AtlasPage* TextureAtlas::createPage()
+	{
+		Uint32 rmask, gmask, bmask, amask;
+		#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		rmask = 0xff000000;
+		gmask = 0x00ff0000;
+		bmask = 0x0000ff00;
+		amask = 0x000000ff;
+		#else
+		rmask = 0x000000ff;
+		gmask = 0x0000ff00;
+		bmask = 0x00ff0000;
+		amask = 0xff000000;
+		#endif
+
+	    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, mPageSize, mPageSize,
+                                                    32, rmask, gmask, bmask, amask);
+        if (!surface)
+        {
+            logger->logError("Unable to create texture atlas page");
+            return NULL;
+        }
+
+        // the padding between textures must be transparent
+        SDL_FillRect(surface, NULL, 0);
+
+        AtlasPage *page = new AtlasPage;
+        page->surface = surface;
+        page->shelfX = 0;
+        page->shelfY = 0;
+        page->shelfHeight = 0;
+        page->texture = 0;
+
+        graphicsEngine->runOnRenderThread(new CreatePageJob(page, mPageSize));
+
+        mPages.push_back(page);
+
+        return page;
+	}
+
+	bool TextureAtlas::place(AtlasPage *page, int w, int h, int &x, int &y)
+	{
+	    // frames of a sheet are the same size, so shelves pack them tightly
+	    if (page->shelfX + w > mPageSize)
+	    {
+	        page->shelfY += page->shelfHeight + PADDING;
+	        page->shelfX = 0;
+	        page->shelfHeight = 0;
+	    }
+
+	    if (page->shelfY + h > mPageSize)
+            return false;
+
+        x = page->shelfX;
+        y = page->shelfY;
+        page->shelfX += w + PADDING;
+        if (h > page->shelfHeight)
+            page->shelfHeight = h;
+
+        return true;
+	}
+}
@@ -0,0 +1,125 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The Texture Atlas packs many small textures into a few large pages,
+ * so they can be drawn without changing the bound texture
+ */
+
+#ifndef ST_TEXTUREATLAS_HEADER
+#define ST_TEXTUREATLAS_HEADER
+
+#include <SDL_opengl.h>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace ST
+{
+	class Texture;
+
+	/**
+	 * A page of the atlas, a copy of its pixels is kept
+	 * so textures on it can be read back without GL.
+	 * The GL texture is made and filled on the render thread
+	 */
+	struct AtlasPage
+	{
+	    GLuint texture;
+	    SDL_Surface *surface;
+	    int shelfX; // where the next texture goes on the current shelf
+	    int shelfY;
+	    int shelfHeight;
+	};
+
+	class TextureAtlas
+	{
+	public:
+		/**
+		 * Constructor
+		 */
+		TextureAtlas();
+
+		/**
+		 * Destructor
+		 * Frees all the pages
+		 */
+		~TextureAtlas();
+
+		/**
+		 * Add Texture
+		 * Copies the surface into a page and points the texture at it
+		 * @param texture The texture to put on a page
+		 * @param surface The 32 bit RGBA pixels of the texture
+		 * @return Returns false if the surface doesnt fit on a page
+		 */
+		bool addTexture(Texture *texture, SDL_Surface *surface);
+
+		/**
+		 * Start Page
+		 * The next texture added goes on a new page,
+		 * even if the last one has room
+		 */
+		void startPage();
+
+	private:
+		/**
+		 * Create Page
+		 * Adds a new empty page
+		 */
+		AtlasPage* createPage();
+
+		/**
+		 * Place
+		 * Finds room for a w by h area on the page, starting a new
+		 * shelf if the current one is full
+		 * @return Returns false if the page has no room left
+		 */
+		bool place(AtlasPage *page, int w, int h, int &x, int &y);
+
+		// space left between textures, so filtering doesnt blend neighbours
+		enum { PADDING = 1 };
+
+		std::vector<AtlasPage*> mPages;
+		int mPageSize;
+		bool mStartPage;
+	};
+}
+
+#endif
@@ -0,0 +1,606 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "hierarchicalpathfinder.h"
+#include "collisionmap.h"
+#include "pathfinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace ST
+{
+    // entrances this long or more get one at each end instead of the middle
+    static const int LONG_ENTRANCE = 6;
+
+    static unsigned int octile(int dx, int dy)
+    {
+        dx = abs(dx);
+        dy = abs(dy);
+        if (dx < dy)
+            std::swap(dx, dy);
+        return Pathfinder::DIAGONAL_COST * dy + Pathfinder::STRAIGHT_COST * (dx - dy);
+    }
+
+	HierarchicalPathfinder::HierarchicalPathfinder() :
+        mMap(NULL),
+        mVersion(0),
+        mWidth(0),
+        mHeight(0),
+        mClustersWide(0),
+        mClustersHigh(0),
+        mGeneration(0),
+        mEndCluster(-1)
+	{
+
+	}
+
+	bool HierarchicalPathfinder::findPath(const CollisionMap &map, const Point &start, const Point &end,
+                                          std::vector<Point> &path)
+	{
+        path.clear();
+
+        if (map.blocked(end.x, end.y))
+            return false;
+
+        // the start is allowed to be blocked, a being could be standing there
+        if (start.x < 0 || start.y < 0 ||
+            start.x >= (int)map.getWidth() || start.y >= (int)map.getHeight())
+            return false;
+
+        if (start.x == end.x && start.y == end.y)
+            return true;
+
+        // the graph is only as good as the collision data it came from
+        if (mMap != &map || mVersion != map.getVersion())
+            build(map);
+
+        int startCluster = getCluster(start.x, start.y);
+        mEndCluster = getCluster(end.x, end.y);
+        mEnd = end;
+
+        // join the start to the entrances of its cluster
+        searchCluster(start);
+
+        // when both are in the same cluster try going straight there
+        if (startCluster == mEndCluster && getLocalDistance(end) != 0xFFFFFFFF)
+        {
+            appendLocalPath(end, path);
+            return true;
+        }
+
+        mStartEdges.clear();
+        mStartSteps.clear();
+        addStartEdges(start, 0);
+
+        // a blocked start on the edge of its cluster might only
+        // be able to step into the next cluster
+        if (map.blocked(start.x, start.y))
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    Point step;
+                    step.x = start.x + dx;
+                    step.y = start.y + dy;
+                    if ((dx == 0 && dy == 0) || map.blocked(step.x, step.y) ||
+                        getCluster(step.x, step.y) == startCluster)
+                        continue;
+
+                    unsigned int cost = Pathfinder::STRAIGHT_COST;
+                    if (dx != 0 && dy != 0)
+                    {
+                        if (map.blocked(step.x, start.y) || map.blocked(start.x, step.y))
+                            continue;
+                        cost = Pathfinder::DIAGONAL_COST;
+                    }
+
+                    searchCluster(step);
+                    addStartEdges(step, cost);
+                }
+            }
+        }
+
+        // moves cost the same both ways, so searching out from
+        // the end gives the cost of reaching it from each entrance
+        searchCluster(end);
+
+        mEndEdges.clear();
+        const std::vector<int> &endNodes = mClusterNodes[mEndCluster];
+        for (unsigned int i = 0; i < endNodes.size(); ++i)
+        {
+            Edge edge;
+            edge.to = endNodes[i];
+            edge.cost = getLocalDistance(mNodes[edge.to].pos);
+            if (edge.cost != 0xFFFFFFFF)
+                mEndEdges.push_back(edge);
+        }
+
+        std::vector<int> route;
+        if (mStartEdges.empty() || mEndEdges.empty() || !searchGraph(route))
+            return false;
+
+        // fill in the tiles between each entrance, crossing between
+        // clusters is a single step and the rest stays inside one cluster
+        Point from = start;
+        for (unsigned int i = 0; i < mStartEdges.size(); ++i)
+        {
+            if (mStartEdges[i].to == route.front() &&
+                (mStartSteps[i].x != start.x || mStartSteps[i].y != start.y))
+            {
+                from = mStartSteps[i];
+                path.push_back(from);
+            }
+        }
+
+        for (unsigned int i = 0; i <= route.size(); ++i)
+        {
+            const Point &to = i < route.size() ? mNodes[route[i]].pos : end;
+
+            if (getCluster(from.x, from.y) != getCluster(to.x, to.y))
+            {
+                path.push_back(to);
+            }
+            else
+            {
+                searchCluster(from, &to);
+                appendLocalPath(to, path);
+            }
+
+            from = to;
+        }
+
+        return true;
+	}
+
+	void HierarchicalPathfinder::addStartEdges(const Point &step, unsigned int stepCost)
+	{
+        const std::vector<int> &nodes = mClusterNodes[getCluster(step.x, step.y)];
+        for (unsigned int i = 0; i < nodes.size(); ++i)
+        {
+            unsigned int distance = getLocalDistance(mNodes[nodes[i]].pos);
+            if (distance == 0xFFFFFFFF)
+                continue;
+
+            // only keep the cheapest way of reaching each entrance
+            unsigned int j = 0;
+            while (j < mStartEdges.size() && mStartEdges[j].to != nodes[i])
+                ++j;
+
+            if (j == mStartEdges.size())
+            {
+                Edge edge;
+                edge.to = nodes[i];
+                edge.cost = stepCost + distance;
+                mStartEdges.push_back(edge);
+                mStartSteps.push_back(step);
+            }
+            else if (stepCost + distance < mStartEdges[j].cost)
+            {
+                mStartEdges[j].cost = stepCost + distance;
+                mStartSteps[j] = step;
+            }
+        }
+	}
+
+	void HierarchicalPathfinder::build(const CollisionMap &map)
+	{
+        mMap = &map;
+        mVersion = map.getVersion();
+        mWidth = map.getWidth();
+        mHeight = map.getHeight();
+        mClustersWide = (mWidth + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+        mClustersHigh = (mHeight + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+        mNodes.clear();
+        mClusterNodes.clear();
+        mClusterNodes.resize(mClustersWide * mClustersHigh);
+        mNodeAt.clear();
+        mNodeAt.resize(mWidth * mHeight, -1);
+
+        // entrances across the borders between columns of clusters
+        for (int x = CLUSTER_SIZE; x < mWidth; x += CLUSTER_SIZE)
+        {
+            for (int y = 0; y < mHeight; y += CLUSTER_SIZE)
+            {
+                addEntrances(x - 1, y, 0, 1, 1, 0, std::min((int)CLUSTER_SIZE, mHeight - y));
+            }
+        }
+
+        // and between rows of clusters
+        for (int y = CLUSTER_SIZE; y < mHeight; y += CLUSTER_SIZE)
+        {
+            for (int x = 0; x < mWidth; x += CLUSTER_SIZE)
+            {
+                addEntrances(x, y - 1, 1, 0, 0, 1, std::min((int)CLUSTER_SIZE, mWidth - x));
+            }
+        }
+
+        // join up the entrances inside each cluster
+        for (unsigned int cluster = 0; cluster < mClusterNodes.size(); ++cluster)
+        {
+            const std::vector<int> &nodes = mClusterNodes[cluster];
+            for (unsigned int i = 0; i < nodes.size(); ++i)
+            {
+                searchCluster(mNodes[nodes[i]].pos);
+                for (unsigned int j = 0; j < nodes.size(); ++j)
+                {
+                    if (i == j)
+                        continue;
+
+                    Edge edge;
+                    edge.to = nodes[j];
+                    edge.cost = getLocalDistance(mNodes[edge.to].pos);
+                    if (edge.cost != 0xFFFFFFFF)
+                        mNodes[nodes[i]].edges.push_back(edge);
+                }
+            }
+        }
+
+        mSearch.clear();
+        mSearch.resize(mNodes.size() + 2);
+        mGeneration = 0;
+	}
+
+	void HierarchicalPathfinder::addEntrances(int x, int y, int dx, int dy, int nx, int ny, int length)
+	{
+        int runStart = -1;
+        for (int i = 0; i <= length; ++i)
+        {
+            int ax = x + dx * i;
+            int ay = y + dy * i;
+            bool open = i < length && !mMap->blocked(ax, ay) && !mMap->blocked(ax + nx, ay + ny);
+
+            if (open)
+            {
+                if (runStart < 0)
+                    runStart = i;
+                continue;
+            }
+
+            if (runStart < 0)
+                continue;
+
+            // the run of free tiles ended on the last one
+            int runEnd = i - 1;
+            Point a, b;
+            if (runEnd - runStart + 1 < LONG_ENTRANCE)
+            {
+                int middle = (runStart + runEnd) / 2;
+                a.x = x + dx * middle;
+                a.y = y + dy * middle;
+                b.x = a.x + nx;
+                b.y = a.y + ny;
+                addTransition(a, b);
+            }
+            else
+            {
+                a.x = x + dx * runStart;
+                a.y = y + dy * runStart;
+                b.x = a.x + nx;
+                b.y = a.y + ny;
+                addTransition(a, b);
+
+                a.x = x + dx * runEnd;
+                a.y = y + dy * runEnd;
+                b.x = a.x + nx;
+                b.y = a.y + ny;
+                addTransition(a, b);
+            }
+
+            runStart = -1;
+        }
+	}
+
+	void HierarchicalPathfinder::addTransition(const Point &a, const Point &b)
+	{
+        int nodeA = getNode(a);
+        int nodeB = getNode(b);
+
+        Edge edge;
+        edge.cost = Pathfinder::STRAIGHT_COST;
+        edge.to = nodeB;
+        mNodes[nodeA].edges.push_back(edge);
+        edge.to = nodeA;
+        mNodes[nodeB].edges.push_back(edge);
+	}
+
+	int HierarchicalPathfinder::getNode(const Point &pt)
+	{
+        int &index = mNodeAt[pt.y * mWidth + pt.x];
+        if (index >= 0)
+            return index;
+
+        index = mNodes.size();
+
+        AbstractNode node;
+        node.pos = pt;
+        node.cluster = getCluster(pt.x, pt.y);
+        mNodes.push_back(node);
+        mClusterNodes[node.cluster].push_back(index);
+
+        return index;
+	}
+
+	int HierarchicalPathfinder::getCluster(int x, int y) const
+	{
+        return (y / CLUSTER_SIZE) * mClustersWide + x / CLUSTER_SIZE;
+	}
+
+	Rectangle HierarchicalPathfinder::getClusterArea(int cluster) const
+	{
+        Rectangle area;
+        area.x = (cluster % mClustersWide) * CLUSTER_SIZE;
+        area.y = (cluster / mClustersWide) * CLUSTER_SIZE;
+        area.width = std::min((int)CLUSTER_SIZE, mWidth - area.x);
+        area.height = std::min((int)CLUSTER_SIZE, mHeight - area.y);
+        return area;
+	}
+
+	void HierarchicalPathfinder::searchCluster(const Point &from, const Point *target)
+	{
+        mLocalArea = getClusterArea(getCluster(from.x, from.y));
+        int width = mLocalArea.width;
+        int height = mLocalArea.height;
+
+        // copy out the rows of the cluster, a bit for each tile
+        CollisionMap::Word rows[CLUSTER_SIZE];
+        for (int y = 0; y < height; ++y)
+        {
+            rows[y] = mMap->getRow(mLocalArea.x, mLocalArea.y + y);
+        }
+
+        std::fill(mLocalDistance, mLocalDistance + width * height, 0xFFFFFFFF);
+
+        int targetIndex = -1;
+        int targetX = 0;
+        int targetY = 0;
+        if (target)
+        {
+            targetX = target->x - mLocalArea.x;
+            targetY = target->y - mLocalArea.y;
+            targetIndex = targetY * width + targetX;
+        }
+
+        std::vector<OpenEntry> &open = mLocalOpen;
+        open.clear();
+
+        OpenEntry entry;
+        entry.index = (from.y - mLocalArea.y) * width + from.x - mLocalArea.x;
+        entry.g = 0;
+        entry.f = 0;
+        mLocalDistance[entry.index] = 0;
+        mLocalParent[entry.index] = -1;
+        open.push_back(entry);
+
+        while (!open.empty())
+        {
+            std::pop_heap(open.begin(), open.end());
+            OpenEntry current = open.back();
+            open.pop_back();
+
+            if (current.g != mLocalDistance[current.index])
+                continue;
+
+            // with a target only the way there is needed
+            if (current.index == targetIndex)
+                return;
+
+            int x = current.index % width;
+            int y = current.index / width;
+
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                int ny = y + dy;
+                if (ny < 0 || ny >= height)
+                    continue;
+
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int nx = x + dx;
+                    if ((dx == 0 && dy == 0) || nx < 0 || nx >= width || ((rows[ny] >> nx) & 1))
+                        continue;
+
+                    unsigned int cost = Pathfinder::STRAIGHT_COST;
+                    if (dx != 0 && dy != 0)
+                    {
+                        // dont cut corners
+                        if (((rows[y] >> nx) & 1) || ((rows[ny] >> x) & 1))
+                            continue;
+                        cost = Pathfinder::DIAGONAL_COST;
+                    }
+
+                    OpenEntry next;
+                    next.index = ny * width + nx;
+                    next.g = current.g + cost;
+                    if (next.g >= mLocalDistance[next.index])
+                        continue;
+
+                    next.f = next.g;
+                    if (target)
+                        next.f += octile(targetX - nx, targetY - ny);
+
+                    mLocalDistance[next.index] = next.g;
+                    mLocalParent[next.index] = current.index;
+                    open.push_back(next);
+                    std::push_heap(open.begin(), open.end());
+                }
+            }
+        }
+	}
+
+	unsigned int HierarchicalPathfinder::getLocalDistance(const Point &pt) const
+	{
+        int x = pt.x - mLocalArea.x;
+        int y = pt.y - mLocalArea.y;
+        if (x < 0 || y < 0 || x >= (int)mLocalArea.width || y >= (int)mLocalArea.height)
+            return 0xFFFFFFFF;
+        return mLocalDistance[y * mLocalArea.width + x];
+	}
+
+	void HierarchicalPathfinder::appendLocalPath(const Point &pt, std::vector<Point> &path)
+	{
+        // walk back to the start of the search, then add them the right way round
+        unsigned int first = path.size();
+        int index = (pt.y - mLocalArea.y) * mLocalArea.width + pt.x - mLocalArea.x;
+        while (mLocalParent[index] >= 0)
+        {
+            Point step;
+            step.x = mLocalArea.x + index % mLocalArea.width;
+            step.y = mLocalArea.y + index / mLocalArea.width;
+            path.push_back(step);
+            index = mLocalParent[index];
+        }
+        std::reverse(path.begin() + first, path.end());
+	}
+
+	bool HierarchicalPathfinder::searchGraph(std::vector<int> &route)
+	{
+        const int startIndex = mNodes.size();
+        const int endIndex = startIndex + 1;
+
+        ++mGeneration;
+
+        // wrapped around, old generations could match again
+        if (mGeneration == 0)
+        {
+            for (unsigned int i = 0; i < mSearch.size(); ++i)
+                mSearch[i].generation = 0;
+            mGeneration = 1;
+        }
+
+        mOpen.clear();
+
+        SearchNode &start = mSearch[startIndex];
+        start.g = 0;
+        start.parent = -1;
+        start.generation = mGeneration;
+        start.closed = false;
+
+        OpenEntry entry;
+        entry.index = startIndex;
+        entry.g = 0;
+        entry.f = 0;
+        mOpen.push_back(entry);
+
+        while (!mOpen.empty())
+        {
+            std::pop_heap(mOpen.begin(), mOpen.end());
+            OpenEntry current = mOpen.back();
+            mOpen.pop_back();
+
+            SearchNode &node = mSearch[current.index];
+            if (node.closed || current.g != node.g)
+                continue;
+            node.closed = true;
+
+            if (current.index == endIndex)
+            {
+                // walk back leaving out the start and end
+                for (int i = node.parent; i != startIndex; i = mSearch[i].parent)
+                    route.push_back(i);
+                std::reverse(route.begin(), route.end());
+                return true;
+            }
+
+            // the start has its own edges, and the end
+            // can be reached from entrances in its cluster
+            const std::vector<Edge> *edges = &mStartEdges;
+            unsigned int endCost = 0xFFFFFFFF;
+            if (current.index != startIndex)
+            {
+                edges = &mNodes[current.index].edges;
+                if (mNodes[current.index].cluster == mEndCluster)
+                {
+                    for (unsigned int i = 0; i < mEndEdges.size(); ++i)
+                    {
+                        if (mEndEdges[i].to == current.index)
+                            endCost = mEndEdges[i].cost;
+                    }
+                }
+            }
+
+            for (unsigned int i = 0; i <= edges->size(); ++i)
+            {
+                int to;
+                unsigned int g;
+                if (i < edges->size())
+                {
+                    to = (*edges)[i].to;
+                    g = current.g + (*edges)[i].cost;
+                }
+                else if (endCost != 0xFFFFFFFF)
+                {
+                    to = endIndex;
+                    g = current.g + endCost;
+                }
+                else
+                {
+                    break;
+                }
+
+                SearchNode &next = mSearch[to];
+                if (next.generation == mGeneration)
+                {
+                    if (next.closed || next.g <= g)
+                        continue;
+                }
+                else
+                {
+                    next.generation = mGeneration;
+                    next.closed = false;
+                }
+
+                next.g = g;
+                next.parent = current.index;
+
+                const Point &pos = to == endIndex ? mEnd : mNodes[to].pos;
+                OpenEntry open;
+                open.index = to;
+                open.g = g;
+                open.f = g + octile(mEnd.x - pos.x, mEnd.y - pos.y);
+                mOpen.push_back(open);
+                std::push_heap(mOpen.begin(), mOpen.end());
+            }
+        }
+
+        return false;
+	}
+}
@@ -0,0 +1,204 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The HierarchicalPathfinder class finds long routes on big maps by
+ * searching a graph of the entrances between clusters of tiles,
+ * then filling in the tiles one cluster at a time
+ */
+
+#ifndef ST_HIERARCHICALPATHFINDER_HEADER
+#define ST_HIERARCHICALPATHFINDER_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "utilities/types.h"
+
+namespace ST
+{
+    class CollisionMap;
+
+	class HierarchicalPathfinder
+	{
+	public:
+	    // width and height in tiles of each cluster
+	    enum { CLUSTER_SIZE = 16 };
+	    // maps smaller than this on both sides are quick enough to search directly
+	    enum { MIN_MAP_SIZE = 128 };
+
+	public:
+		HierarchicalPathfinder();
+
+		/**
+		 * Find Path
+		 * Finds a route between two tiles using the same moves as the
+		 * Pathfinder. The route is close to the shortest, but not always it.
+		 * The cluster graph is rebuilt when the collision data changes
+		 * @param map The collision data to search
+		 * @param start The tile to start from
+		 * @param end The tile to finish on
+		 * @param path Filled with every tile stepped on, not including start
+		 * @return Returns whether a path was found
+		 */
+        bool findPath(const CollisionMap &map, const Point &start, const Point &end,
+                      std::vector<Point> &path);
+
+        /**
+         * Get Node Count
+         * @return Returns the number of entrances in the cluster graph
+         */
+        unsigned int getNodeCount() const { return mNodes.size(); }
+
+	private:
+        struct Edge
+        {
+            int to;
+            unsigned int cost;
+        };
+
+        struct AbstractNode
+        {
+            Point pos;
+            int cluster;
+            std::vector<Edge> edges;
+        };
+
+        struct SearchNode
+        {
+            unsigned int g;
+            int parent;
+            unsigned int generation; // search the node belongs to
+            bool closed;
+        };
+
+        struct OpenEntry
+        {
+            unsigned int f;
+            unsigned int g;
+            int index;
+
+            // reversed so the heap returns the lowest cost first
+            bool operator<(const OpenEntry &other) const
+            {
+                if (f != other.f)
+                    return f > other.f;
+                return g < other.g;
+            }
+        };
+
+        /**
+         * Build the cluster graph from the collision data
+         */
+        void build(const CollisionMap &map);
+
+        /**
+         * Add entrances along the border between two tiles that are
+         * next to each other, for each run of tiles free on both sides
+         * @param x, y The first tile on the near side of the border
+         * @param dx, dy The step along the border
+         * @param nx, ny The step across the border
+         * @param length The number of tiles along the border
+         */
+        void addEntrances(int x, int y, int dx, int dy, int nx, int ny, int length);
+        void addTransition(const Point &a, const Point &b);
+        int getNode(const Point &pt);
+
+        int getCluster(int x, int y) const;
+        Rectangle getClusterArea(int cluster) const;
+
+        /**
+         * Search outwards from a tile without leaving the cluster it is in,
+         * filling mLocalDistance and mLocalParent
+         * @param target Stop once the way to this tile is found
+         */
+        void searchCluster(const Point &from, const Point *target = NULL);
+        unsigned int getLocalDistance(const Point &pt) const;
+
+        /**
+         * Add the tiles of the last cluster search from its start to pt
+         */
+        void appendLocalPath(const Point &pt, std::vector<Point> &path);
+
+        /**
+         * Join the start to the entrances of a cluster using the last
+         * cluster search, which started from step
+         * @param step The start, or the tile next to it that was searched from
+         * @param stepCost The cost of moving from the start to step
+         */
+        void addStartEdges(const Point &step, unsigned int stepCost);
+
+        /**
+         * Search the cluster graph, start and end are joined to it
+         * through mStartEdges and mEndEdges
+         * @return Returns the entrances to go through, not including start or end
+         */
+        bool searchGraph(std::vector<int> &route);
+
+	private:
+        const CollisionMap *mMap;
+        unsigned int mVersion; // of the collision data the graph was built from
+        int mWidth;
+        int mHeight;
+        int mClustersWide;
+        int mClustersHigh;
+
+        std::vector<AbstractNode> mNodes;
+        std::vector<std::vector<int> > mClusterNodes; // entrances in each cluster
+        std::vector<int> mNodeAt; // entrance at each tile, or -1
+
+        // one entry for every node, plus the start and end
+        std::vector<SearchNode> mSearch;
+        std::vector<OpenEntry> mOpen;
+        unsigned int mGeneration;
+        std::vector<Edge> mStartEdges;
+        std::vector<Point> mStartSteps; // first tile stepped on for each start edge
+        std::vector<Edge> mEndEdges; // from entrances in the end cluster
+        int mEndCluster;
+        Point mEnd;
+
+        // results of the last cluster search
+        Rectangle mLocalArea;
+        std::vector<OpenEntry> mLocalOpen;
+        unsigned int mLocalDistance[CLUSTER_SIZE * CLUSTER_SIZE];
+        int mLocalParent[CLUSTER_SIZE * CLUSTER_SIZE];
+	};
+}
+
+#endif
@@ -230,6 +230,23 @@ namespace ST
 		}
 	}
 
+	void InterfaceManager::getWindowAreas(std::vector<Rectangle> &areas)
+	{
+		AG_Window *win;
+		AG_FOREACH_WINDOW(win, agDriverSw)
+		{
+		    if (!AG_WindowIsVisible(win))
+                continue;
+
+		    Rectangle area;
+		    area.x = AGWIDGET(win)->x;
+		    area.y = AGWIDGET(win)->y;
+		    area.width = AGWIDGET(win)->w;
+		    area.height = AGWIDGET(win)->h;
+		    areas.push_back(area);
+		}
+	}
+
 	void InterfaceManager::moveWindows(bool force)
 	{
 	    Point camPt;
@@ -343,6 +360,8 @@ namespace ST
 	    AG_Surface *surface = NULL;
 	    if (graphicsEngine->isOpenGL())
         {
+            // the texture may still be being made on the render thread
+            graphicsEngine->finishFrame();
             AG_PixmapFromTexture(mNPCAvatar, 0, resourceManager->getBeingAvatar(being->getId())->getGLTexture(), 0);
         }
         else
@@ -350,20 +369,11 @@ namespace ST
             SDL_Surface *s = resourceManager->getBeingAvatar(being->getId())->getSDLSurface();
             if (s)
             {
+                // textures are kept in the display format, so use its masks
                 SDL_LockSurface(s);
-                unsigned int rmask, gmask, bmask, amask;
-                #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                rmask = 0xff000000;
-                gmask = 0x00ff0000;
-                bmask = 0x0000ff00;
-                amask = 0x000000ff;
-                #else
-                rmask = 0x000000ff;
-                gmask = 0x0000ff00;
-                bmask = 0x00ff0000;
-                amask = 0xff000000;
-                #endif
-                surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, s->format->BitsPerPixel, rmask, gmask, bmask, amask);
+                SDL_PixelFormat *format = s->format;
+                surface = AG_SurfaceFromPixelsRGBA(s->pixels, s->w, s->h, format->BitsPerPixel,
+                                                   format->Rmask, format->Gmask, format->Bmask, format->Amask);
                 SDL_UnlockSurface(s);
                 AG_PixmapFromSurface(mNPCAvatar, 0, surface);
             }
@@ -49,6 +49,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 #include <SDL.h>
 #include <agar/core.h>
 #include <agar/gui.h>
@@ -136,6 +137,12 @@ namespace ST
 		 */
         void moveWindows(bool force = false);
 
+        /**
+         * Get Window Areas
+         * Adds the screen area of each visible window to the list
+         */
+        void getWindowAreas(std::vector<Rectangle> &areas);
+
 		/**
 		 * Draw name
 		 */
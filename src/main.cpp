@@ -42,12 +42,49 @@
 #include "game.h"
 
 #include <SDL.h>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined _WIN32 && !defined __APPLE__
+#include <X11/Xlib.h>
+#endif
 
 ST::Game *game = 0;
 
 int main(int argc, char *argv[])
 {
+#if !defined _WIN32 && !defined __APPLE__
+	// the render thread swaps buffers while this one reads events,
+	// Xlib must be told before the display is opened
+	XInitThreads();
+#endif
+
 	game = new ST::Game(argv[0]);
+
+	for (int i = 1; i < argc; ++i)
+	{
+	    if (strcmp(argv[i], "--headless") == 0)
+	    {
+	        // run without a display, for benchmarks and bots
+            game->setHeadless(true);
+	    }
+	    else if (strcmp(argv[i], "--capture") == 0 && i + 2 < argc)
+	    {
+	        // save the draw commands of the first frames
+	        game->setCapture(argv[i + 1], atoi(argv[i + 2]));
+	        i += 2;
+	    }
+	    else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+	    {
+	        // draw a capture as fast as possible, then quit
+	        std::string filename = argv[++i];
+	        int loops = 1;
+	        if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                loops = atoi(argv[++i]);
+	        game->setReplay(filename, loops);
+	    }
+	}
+
 	game->run();
 	delete game;
 	return 0;
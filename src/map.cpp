@@ -45,23 +45,52 @@
 #include "graphics/node.h"
 #include "graphics/texture.h"
 
-#include "utilities/base64.h"
-#include "utilities/gzip.h"
+#include "mapformat.h"
+
 #include "utilities/log.h"
+#include "utilities/mappedfile.h"
 #include "utilities/math.h"
+#include "utilities/threadpool.h"
+#include "utilities/tiledecoder.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <sstream>
 #include <tinyxml.h>
+#include <zlib.h>
 
 namespace ST
 {
+	Layer::Chunk::Chunk()
+	{
+        std::fill(index, index + CHUNK_SIZE * CHUNK_SIZE, (Node*)NULL);
+	}
+
+	Layer::TileChunk::TileChunk() :
+		packed(NULL),
+		packedSize(0),
+		tiles(NULL),
+		empty(false)
+	{
+	}
+
 	Layer::Layer(const std::string &name, unsigned int width, unsigned int height) :
+		mEmptySlots(0),
+		mTileData(NULL),
+		mHasTiles(false),
 		mName(name),
 		mWidth(width),
 		mHeight(height),
+		mMaxNodeWidth(0),
+		mMaxNodeHeight(0),
 		mCollisionLayer(false)
 	{
+        mChunksWide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        mChunksHigh = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        mChunks.resize(mChunksWide * mChunksHigh, NULL);
 
+        // with one more bucket for nodes outside the map
+        mBuckets.resize(mChunks.size() + 1);
 	}
 
 	Layer::~Layer()
@@ -76,6 +105,19 @@ namespace ST
 			++itr;
 		}
 		mNodes.clear();
+
+		for (unsigned int i = 0; i < mChunks.size(); ++i)
+		{
+		    delete mChunks[i];
+		}
+		mChunks.clear();
+
+		for (unsigned int i = 0; i < mTileChunks.size(); ++i)
+		{
+		    free(mTileChunks[i].packed);
+		    free(mTileChunks[i].tiles);
+		}
+		mTileChunks.clear();
 	}
 
 	void Layer::setCollisionLayer()
@@ -83,55 +125,417 @@ namespace ST
 	    mCollisionLayer = true;
 	}
 
-	void Layer::setTile(int x, int y, Texture *tex, int width, int height)
+	// copies the ids of a chunk out of the layer data, tiles past
+	// the edge of the layer are left empty
+	static void readChunkIds(const unsigned char *data, unsigned int width, unsigned int height,
+	                         unsigned int startX, unsigned int startY, int *ids)
 	{
-	    std::stringstream str;
-	    Point p;
+	    const unsigned int size = Layer::CHUNK_SIZE;
+	    std::fill(ids, ids + size * size, 0);
+
+	    unsigned int endX = std::min(startX + size, width);
+	    unsigned int endY = std::min(startY + size, height);
+	    for (unsigned int y = startY; y < endY; ++y)
+	    {
+	        const unsigned char *row = data + (y * width + startX) * 4;
+	        int *out = ids + (y - startY) * size;
+	        for (unsigned int x = startX; x < endX; ++x, row += 4)
+	        {
+	            // get the tile id by putting
+	            // the data bytes into an integer
+	            *out++ = row[0] | row[1] << 8 | row[2] << 16 | row[3] << 24;
+	        }
+	    }
+	}
+
+	void Layer::packTileData(const unsigned char *data)
+	{
+	    const unsigned int count = CHUNK_SIZE * CHUNK_SIZE;
+	    int ids[count];
+
+	    mTileData = NULL;
+	    mTileChunks.resize(mChunks.size());
+
+	    for (unsigned int cy = 0; cy < mChunksHigh; ++cy)
+	    {
+	        for (unsigned int cx = 0; cx < mChunksWide; ++cx)
+	        {
+	            TileChunk &chunk = mTileChunks[cy * mChunksWide + cx];
+	            readChunkIds(data, mWidth, mHeight, cx * CHUNK_SIZE, cy * CHUNK_SIZE, ids);
+
+	            // chunks with no tiles, common on the upper layers, store nothing
+	            chunk.empty = true;
+	            for (unsigned int i = 0; i < count; ++i)
+	            {
+	                if (ids[i])
+	                {
+	                    chunk.empty = false;
+	                    break;
+	                }
+	            }
+	            if (chunk.empty)
+                    continue;
+
+                uLongf size = compressBound(sizeof(ids));
+                chunk.packed = (unsigned char*) malloc(size);
+                if (!chunk.packed ||
+                    compress2(chunk.packed, &size, (const Bytef*) ids, sizeof(ids), Z_BEST_SPEED) != Z_OK)
+                {
+                    logger->logError("Unable to pack tiles for layer " + mName);
+                    free(chunk.packed);
+                    chunk.packed = NULL;
+                    chunk.empty = true;
+                    continue;
+                }
+
+                // give back what the compression didnt use
+                unsigned char *packed = (unsigned char*) realloc(chunk.packed, size);
+                if (packed)
+                    chunk.packed = packed;
+                chunk.packedSize = size;
+	        }
+	    }
+
+	    mHasTiles = true;
+	}
+
+	void Layer::setTileData(const unsigned char *data)
+	{
+	    mTileData = data;
+	    mTileChunks.resize(mChunks.size());
+	    mHasTiles = true;
+	}
+
+	int Layer::getTileId(unsigned int x, unsigned int y)
+	{
+	    if (!mHasTiles || x >= mWidth || y >= mHeight)
+            return 0;
+
+        TileChunk &chunk = mTileChunks[(y / CHUNK_SIZE) * mChunksWide + x / CHUNK_SIZE];
+        if (!chunk.tiles)
+        {
+            if (chunk.empty)
+                return 0;
+
+            // tiles just outside the loaded area, such as when baking
+            loadTileChunk(x / CHUNK_SIZE, y / CHUNK_SIZE);
+            if (!chunk.tiles)
+                return 0;
+        }
+
+        return chunk.tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+	}
+
+	bool Layer::isTileChunkLoaded(unsigned int cx, unsigned int cy) const
+	{
+	    if (!mHasTiles || cx >= mChunksWide || cy >= mChunksHigh)
+            return false;
+
+	    return mTileChunks[cy * mChunksWide + cx].tiles != NULL;
+	}
+
+	void Layer::loadTileChunk(unsigned int cx, unsigned int cy)
+	{
+	    if (!mHasTiles || cx >= mChunksWide || cy >= mChunksHigh)
+            return;
+
+        TileChunk &chunk = mTileChunks[cy * mChunksWide + cx];
+        if (chunk.tiles || chunk.empty)
+            return;
+
+        const unsigned int size = CHUNK_SIZE * CHUNK_SIZE * sizeof(int);
+        chunk.tiles = (int*) malloc(size);
+        if (!chunk.tiles)
+        {
+            logger->logError("Error: Out of memory while loading tiles!");
+            return;
+        }
+
+        if (mTileData)
+        {
+            readChunkIds(mTileData, mWidth, mHeight, cx * CHUNK_SIZE, cy * CHUNK_SIZE, chunk.tiles);
+            return;
+        }
 
-	    str << "tile" << x << "-" << y;
-		p.x = 0.5 * (x - y) * width;
-		p.y = 0.5 * (x + y) * height;
+        uLongf length = size;
+        if (uncompress((Bytef*) chunk.tiles, &length, chunk.packed, chunk.packedSize) != Z_OK ||
+            length != size)
+        {
+            // dont try again every frame
+            logger->logError("Unable to unpack tiles for layer " + mName);
+            free(chunk.tiles);
+            chunk.tiles = NULL;
+            chunk.empty = true;
+        }
+	}
+
+	void Layer::unloadTileChunk(unsigned int cx, unsigned int cy)
+	{
+	    if (!mHasTiles || cx >= mChunksWide || cy >= mChunksHigh)
+            return;
 
-	    // add node and set its position
-        Node *node = new Node(str.str(), tex);
-        node->moveNode(&p);
-        addNode(node);
+        TileChunk &chunk = mTileChunks[cy * mChunksWide + cx];
+        free(chunk.tiles);
+        chunk.tiles = NULL;
 	}
 
 	void Layer::addNode(Node *node)
 	{
+	    NodeHandle &handle = node->getLayerHandle();
+	    if (handle.layer)
+	    {
+	        logger->logWarning("Node " + node->getName() + " is already in layer " +
+                               handle.layer->getName());
+            return;
+	    }
+
+	    handle.layer = this;
+	    handle.slot = mNodes.size();
         mNodes.push_back(node);
+        reorderNode(node);
+
+        addToBucket(node, getBucket(node));
+
+        if (graphicsEngine)
+            graphicsEngine->markDirty(node);
+
+        // updateNode moves it in the index when it changes tile
+        Point pt = node->getTilePosition();
+        if (pt.x >= 0 && pt.y >= 0)
+            indexNode(node, pt.x, pt.y);
+	}
+
+	Layer::Chunk* Layer::getChunk(unsigned int x, unsigned int y, bool create)
+	{
+	    if (x >= mWidth || y >= mHeight)
+            return NULL;
+
+	    Chunk *&chunk = mChunks[(y / CHUNK_SIZE) * mChunksWide + x / CHUNK_SIZE];
+	    if (!chunk && create)
+            chunk = new Chunk;
+
+	    return chunk;
+	}
+
+	void Layer::indexNode(Node *node, unsigned int x, unsigned int y)
+	{
+	    Chunk *chunk = getChunk(x, y, true);
+	    if (!chunk)
+            return;
+
+        Node *&slot = chunk->index[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+        if (!slot)
+        {
+            slot = node;
+            node->getLayerHandle().tileX = x;
+            node->getLayerHandle().tileY = y;
+        }
 	}
 
+	void Layer::unindexNode(Node *node)
+	{
+	    NodeHandle &handle = node->getLayerHandle();
+	    if (handle.tileX < 0)
+            return;
+
+        int x = handle.tileX;
+        int y = handle.tileY;
+        Chunk *chunk = getChunk(x, y, false);
+        chunk->index[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE] = NULL;
+
+        handle.tileX = -1;
+        handle.tileY = -1;
+
+        // another node may be standing on the tile, it takes its place
+        const std::vector<Node*> &bucket = mBuckets[(y / CHUNK_SIZE) * mChunksWide + x / CHUNK_SIZE];
+        for (unsigned int i = 0; i < bucket.size(); ++i)
+        {
+            Point pt = bucket[i]->getTilePosition();
+            if (bucket[i] != node && pt.x == x && pt.y == y)
+            {
+                indexNode(bucket[i], x, y);
+                break;
+            }
+        }
+	}
+
 	void Layer::removeNode(Node *node)
 	{
-	    NodeItr itr = mNodes.begin(), itr_end = mNodes.end();
-	    while (itr != itr_end)
-	    {
-	        if ((*itr)->getName() == node->getName())
-	        {
-	            mNodes.erase(itr);
-	            return;
-	        }
-	        ++itr;
-	    }
+	    NodeHandle &handle = node->getLayerHandle();
+	    if (handle.layer != this)
+            return;
+
+        // leave the slot empty, the others dont need to move
+        mNodes[handle.slot] = NULL;
+        ++mEmptySlots;
+
+        removeFromBucket(node);
+
+        if (graphicsEngine)
+            graphicsEngine->markDirty(node);
+
+        // clear it from the tile it was indexed at
+        unindexNode(node);
+
+        handle.layer = NULL;
+        handle.slot = -1;
+
+        if (mEmptySlots >= MIN_EMPTY_SLOTS && mEmptySlots * 4 >= mNodes.size())
+            compactNodes();
 	}
 
-	Node* Layer::getNodeAt(unsigned int x, unsigned int y)
+	void Layer::compactNodes()
+	{
+	    if (mEmptySlots == 0)
+            return;
+
+	    unsigned int used = 0;
+	    for (unsigned int i = 0; i < mNodes.size(); ++i)
+	    {
+	        Node *node = mNodes[i];
+	        if (!node)
+                continue;
+
+            mNodes[used] = node;
+            node->getLayerHandle().slot = used;
+            ++used;
+	    }
+
+	    mNodes.resize(used);
+	    mEmptySlots = 0;
+	}
+
+	void Layer::updateNode(Node *node)
+	{
+	    NodeHandle &handle = node->getLayerHandle();
+	    if (handle.layer != this)
+            return;
+
+        // the size may have changed with its texture
+        mMaxNodeWidth = std::max(mMaxNodeWidth, node->getWidth() + abs(node->getAnchor()));
+        mMaxNodeHeight = std::max(mMaxNodeHeight, node->getHeight());
+
+        reorderNode(node);
+
+        // keep it indexed at the tile it is standing on
+        Point pt = node->getTilePosition();
+        if (pt.x != handle.tileX || pt.y != handle.tileY)
+        {
+            unindexNode(node);
+            if (pt.x >= 0 && pt.y >= 0)
+                indexNode(node, pt.x, pt.y);
+        }
+
+	    int bucket = getBucket(node);
+	    if (bucket == handle.bucket)
+            return;
+
+        removeFromBucket(node);
+        addToBucket(node, bucket);
+	}
+
+	void Layer::getNodesInArea(const Point &start, const Point &end, std::vector<Node*> &nodes)
 	{
-	    NodeItr itr = mNodes.begin(), itr_end = mNodes.end();
-	    while (itr != itr_end)
+	    int startX = std::max(start.x, 0) / CHUNK_SIZE;
+	    int startY = std::max(start.y, 0) / CHUNK_SIZE;
+	    int endX = std::min(end.x, (int)mWidth - 1) / CHUNK_SIZE;
+	    int endY = std::min(end.y, (int)mHeight - 1) / CHUNK_SIZE;
+
+	    for (int y = startY; y <= endY; ++y)
 	    {
-	        Node *node = *itr;
-	        Point pt = node->getTilePosition();
-	        if (pt.x == x && pt.y == y)
+	        for (int x = startX; x <= endX; ++x)
 	        {
-	            return node;
+	            const std::vector<Node*> &bucket = mBuckets[y * mChunksWide + x];
+	            nodes.insert(nodes.end(), bucket.begin(), bucket.end());
 	        }
-	        ++itr;
 	    }
 
-	    return NULL;
+	    const std::vector<Node*> &outside = mBuckets.back();
+	    nodes.insert(nodes.end(), outside.begin(), outside.end());
+	}
+
+	int Layer::getBucket(Node *node)
+	{
+	    Point pt = node->getTilePosition();
+	    if (pt.x < 0 || pt.y < 0 || pt.x >= (int)mWidth || pt.y >= (int)mHeight)
+            return mBuckets.size() - 1;
+
+        return (pt.y / CHUNK_SIZE) * mChunksWide + pt.x / CHUNK_SIZE;
+	}
+
+	void Layer::addToBucket(Node *node, int bucket)
+	{
+	    NodeHandle &handle = node->getLayerHandle();
+	    handle.bucket = bucket;
+	    handle.bucketSlot = mBuckets[bucket].size();
+	    mBuckets[bucket].push_back(node);
+
+        mMaxNodeWidth = std::max(mMaxNodeWidth, node->getWidth() + abs(node->getAnchor()));
+        mMaxNodeHeight = std::max(mMaxNodeHeight, node->getHeight());
+	}
+
+	void Layer::removeFromBucket(Node *node)
+	{
+	    NodeHandle &handle = node->getLayerHandle();
+	    std::vector<Node*> &bucket = mBuckets[handle.bucket];
+
+	    Node *last = bucket.back();
+	    bucket[handle.bucketSlot] = last;
+	    last->getLayerHandle().bucketSlot = handle.bucketSlot;
+	    bucket.pop_back();
+
+	    handle.bucket = -1;
+	    handle.bucketSlot = -1;
+	}
+
+	void Layer::reorderNode(Node *node)
+	{
+	    int slot = node->getLayerHandle().slot;
+	    int depth = getDepth(node);
+	    int size = mNodes.size();
+
+	    // shift the nodes it passes over into the space it leaves,
+	    // empty slots are passed over and shifted the same way
+	    while (slot > 0)
+	    {
+	        Node *other = mNodes[slot - 1];
+	        if (other && getDepth(other) <= depth)
+                break;
+
+	        mNodes[slot] = other;
+	        if (other)
+                other->getLayerHandle().slot = slot;
+	        --slot;
+	    }
+
+	    while (slot + 1 < size)
+	    {
+	        Node *other = mNodes[slot + 1];
+	        if (other && getDepth(other) >= depth)
+                break;
+
+	        mNodes[slot] = other;
+	        if (other)
+                other->getLayerHandle().slot = slot;
+	        ++slot;
+	    }
+
+	    mNodes[slot] = node;
+	    node->getLayerHandle().slot = slot;
+	}
+
+	int Layer::getDepth(Node *node)
+	{
+	    return node->getPosition().y - node->getHeight();
+	}
+
+	Node* Layer::getNodeAt(unsigned int x, unsigned int y)
+	{
+	    Chunk *chunk = getChunk(x, y, false);
+	    if (!chunk)
+            return NULL;
+
+	    return chunk->index[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
 	}
 
     Layer::NodeItr Layer::getFrontNode()
@@ -144,6 +548,18 @@ namespace ST
         return mNodes.end();
     }
 
+    void Layer::sortNodes()
+    {
+        compactNodes();
+        sortNodes(0, mNodes.size());
+
+        // the nodes have moved, so their handles need updating
+        for (unsigned int i = 0; i < mNodes.size(); ++i)
+        {
+            mNodes[i]->getLayerHandle().slot = i;
+        }
+    }
+
     void Layer::sortNodes(int first, int size)
     {
         Node *pivot;
@@ -222,7 +638,7 @@ namespace ST
 
     int Layer::getSize() const
     {
-        return mNodes.size();
+        return mNodes.size() - mEmptySlots;
     }
 
 	Map::Map()
@@ -232,6 +648,12 @@ namespace ST
         mTileWidth = 0;
         mTileHeight = 0;
         mLoaded = false;
+        mMapBuffer = NULL;
+        mMaxTileWidth = 0;
+        mMaxTileHeight = 0;
+        mChunkStart.x = mChunkStart.y = -1;
+        mChunkEnd.x = mChunkEnd.y = -1;
+        mChunkRadius = 1;
 
 		mTileWalk[0].x = 0;
 		mTileWalk[0].y = -1;
@@ -253,11 +675,34 @@ namespace ST
 
 	Map::~Map()
 	{
-
+        free(mMapBuffer);
 	}
 
 	bool Map::loadMap(const std::string &filename)
 	{
+	    // use the compiled version of the map if there is one,
+	    // it skips parsing the xml and decompressing the layers
+	    std::string binaryFile = filename.substr(0, filename.rfind('.')) + ".stmap";
+	    if (resourceManager->doesExist(binaryFile))
+	    {
+	        // it is only used if it was compiled from this version of the map
+	        std::string source;
+	        if (resourceManager->doesExist(filename))
+	            source = filename;
+
+	        if (loadBinaryMap(binaryFile, source))
+	        {
+	            logger->logDebug("Finished loading map");
+	            mLoaded = true;
+	            if (graphicsEngine)
+                    graphicsEngine->markAllDirty();
+	            return true;
+	        }
+
+	        logger->logWarning("Unable to use " + binaryFile + ", loading " + filename + " instead");
+	        unload();
+	    }
+
 	    std::string file = resourceManager->getDataPath(filename);
         logger->logDebug("Loading map " + file);
 
@@ -297,17 +742,7 @@ namespace ST
             return false;
         }
 
-        int numLayers = 0;
-        while(1)
-        {
-            e = map.Child("layer", numLayers).ToElement();
-
-            if (!loadLayer(e))
-            {
-                break;
-            }
-            ++numLayers;
-        }
+        int numLayers = loadLayers(map.ToElement());
         if (numLayers == 0)
         {
             logger->logError("No layers found!");
@@ -317,6 +752,8 @@ namespace ST
         logger->logDebug("Finished loading map");
 
         mLoaded = true;
+        if (graphicsEngine)
+            graphicsEngine->markAllDirty();
 
         return true;
     }
@@ -328,6 +765,32 @@ namespace ST
             delete mLayers[i];
         }
         mLayers.clear();
+
+        // anything drawn from the old map is out of date
+        if (graphicsEngine)
+        {
+            graphicsEngine->clearStaticCache();
+            graphicsEngine->markAllDirty();
+        }
+
+        for (unsigned i = 0; i < mTilesets.size(); ++i)
+        {
+            delete mTilesets[i];
+        }
+        mTilesets.clear();
+        mTileTextures.clear();
+        mCollision.clear();
+        mFlowFields.clear();
+
+        // the layers are deleted so nothing points into the map data now
+        mMapFile.close();
+        free(mMapBuffer);
+        mMapBuffer = NULL;
+        mMaxTileWidth = 0;
+        mMaxTileHeight = 0;
+        mChunkStart.x = mChunkStart.y = -1;
+        mChunkEnd.x = mChunkEnd.y = -1;
+
         mWidth = 0;
         mHeight = 0;
         mTileWidth = 0;
@@ -364,48 +827,55 @@ namespace ST
         return newPos;
     }
 
-    Node* Map::getTile(const Point &pos, int dir)
+    int Map::getTileId(const Point &pos, int dir)
     {
         Point newPos = walkMap(pos, dir);
 
-        int tilex = 0.5 * (newPos.x - newPos.y) * mTileWidth;
-        int tiley = 0.5 * (newPos.x + newPos.y) * mTileHeight;
-
-        return mLayers[0]->getNodeAt(tilex,tiley);
+        return getTileId(newPos.x, newPos.y, 0);
     }
 
-    Node* Map::getTile(const Point &pos)
+    int Map::getTileId(const Point &pos)
     {
         Point tilePos = convertPixelToTile(pos.x, pos.y);
 
-        return mLayers[0]->getNodeAt(tilePos.x, tilePos.y);
+        return getTileId(tilePos.x, tilePos.y, 0);
     }
 
-    Node* Map::getTile(int x, int y, unsigned int layer)
+    int Map::getTileId(int x, int y, unsigned int layer)
     {
-        if (layer >= mLayers.size())
-            return NULL;
-        return mLayers[layer]->getNodeAt(x, y);
+        if (layer >= mLayers.size() || x < 0 || y < 0)
+            return 0;
+        return mLayers[layer]->getTileId(x, y);
     }
 
     bool Map::blocked(const Point &pos)
     {
         assert(mLayers.size() > 1);
-        if (pos.x < 0 || pos.x > mWidth || pos.y < 0 || pos.y > mHeight)
-            return true;
-        LayerItr itr = mLayers.begin(), itr_end = mLayers.end();
-        while (itr != itr_end)
-        {
-            if ((*itr)->isCollisionLayer())
-            {
-                Node *node = (*itr)->getNodeAt(pos.x, pos.y);
-                if (!node)
-                    return false;
-                return true;
-            }
-            ++itr;
+        return mCollision.blocked(pos.x, pos.y);
+    }
+
+    bool Map::findPath(const Point &start, const Point &end, std::vector<Point> &path)
+    {
+        // building a field searches every tile, which costs more than
+        // searching between clusters on big maps
+        if (std::max(mWidth, mHeight) >= HierarchicalPathfinder::MIN_MAP_SIZE)
+        {
+            // long routes search between clusters instead of tiles
+            int distance = std::max(abs(end.x - start.x), abs(end.y - start.y));
+            if (distance > 2 * HierarchicalPathfinder::CLUSTER_SIZE)
+            {
+                return mHierarchicalPathfinder.findPath(mCollision, start, end, path);
+            }
+        }
+        else
+        {
+            // popular destinations are read from their field without searching
+            const FlowField *field = mFlowFields.getField(mCollision, start, end);
+            if (field)
+                return field->getPath(start, path);
         }
-        return false;
+
+        return mPathfinder.findPath(mCollision, start, end, path);
     }
 
 	bool Map::loadMapInfo(TiXmlElement* e)
@@ -440,6 +910,9 @@ namespace ST
             return false;
         }
 
+        // nothing blocks until the collision layer is loaded
+        mCollision.create(mWidth, mHeight);
+
         return true;
 	}
 
@@ -457,6 +930,13 @@ namespace ST
             return false;
 		}
 
+		// tile id 0 is an empty tile
+		if (id < 1 || id > MAX_TILE_ID)
+		{
+			logger->logError("Invalid tile id for tileset");
+            return false;
+		}
+
 		int width = 0;
 		int height = 0;
 		if (e->QueryIntAttribute("tilewidth", &width) != TIXML_SUCCESS)
@@ -477,13 +957,18 @@ namespace ST
 
 		std::string imagefile = e->Attribute("source");
 
-        if (imagefile.empty())
+        return addTileset(id, width, height, imagefile);
+	}
+
+	bool Map::addTileset(int id, int width, int height, const std::string &source)
+	{
+        if (source.empty())
         {
             logger->logError("No source for image");
             return false;
         }
 
-        imagefile = resourceManager->getDataPath(imagefile);
+        std::string imagefile = resourceManager->getDataPath(source);
 
         if (imagefile.empty())
         {
@@ -491,12 +976,26 @@ namespace ST
             return false;
         }
 
-        if (!graphicsEngine->loadTextureSet(imagefile, width, height))
+        std::vector<Texture*> textures;
+        if (!graphicsEngine->loadTextureSet(imagefile, width, height, textures))
         {
             logger->logError("Unable to load texture for map");
             return false;
         }
 
+        // store where each tile id's texture is, so tiles dont need
+        // to search the tilesets or look the texture up by name
+        if (mTileTextures.size() < id + textures.size())
+            mTileTextures.resize(id + textures.size(), NULL);
+
+        for (unsigned int i = 0; i < textures.size(); ++i)
+        {
+            mTileTextures[id + i] = textures[i];
+        }
+
+        mMaxTileWidth = std::max(mMaxTileWidth, width);
+        mMaxTileHeight = std::max(mMaxTileHeight, height);
+
 		Tileset *tileset = new Tileset;
 		tileset->id = id;
 		tileset->width = width;
@@ -507,131 +1006,532 @@ namespace ST
         return true;
 	}
 
-	bool Map::loadLayer(TiXmlElement *e)
+	// a layer read from the xml, waiting for its tiles to be decoded
+	class PendingLayer
 	{
-	    if (!e)
+	public:
+	    PendingLayer() :
+	        width(0), height(0), text(NULL), encoding(NULL), compression(NULL),
+	        data(NULL), size(0), error(NULL)
+	    {
+	    }
+
+	    // reads the attributes on the main thread, so errors can be logged
+	    bool read(TiXmlElement *e)
+	    {
+	        if (e->QueryIntAttribute("width", &width) != TIXML_SUCCESS)
+            {
+                logger->logError("No layer width");
+                return false;
+            }
+
+            if (e->QueryIntAttribute("height", &height) != TIXML_SUCCESS)
+            {
+                logger->logError("No layer height");
+                return false;
+            }
+
+            // layer name is optional, needed for collision layer
+            const char *layerName = e->Attribute("name");
+            name = layerName ? layerName : "";
+
+            // characters are added to this layer, it has no data
+            if (name == "Character")
+                return true;
+
+            TiXmlElement *dataElement = e->FirstChildElement("data");
+            text = dataElement ? dataElement->GetText() : NULL;
+            if (!text)
+            {
+                logger->logError("No data");
+                return false;
+            }
+
+            encoding = dataElement->Attribute("encoding");
+            compression = dataElement->Attribute("compression");
+
+            return true;
+	    }
+
+	    // decodes into a buffer the exact size of the layer
+	    void decode(TileDecoder &decoder)
+	    {
+	        size = width * height * 4;
+	        data = (unsigned char*) malloc(size);
+	        if (!data)
+	        {
+	            error = "Error: Out of memory while decoding map data!";
+	            size = 0;
+	            return;
+	        }
+
+	        if (!decoder.decode(text, encoding, compression, data, size))
+	        {
+	            error = decoder.getError();
+	            free(data);
+	            data = NULL;
+	            size = 0;
+	        }
+	    }
+
+	public:
+	    std::string name;
+	    int width;
+	    int height;
+	    const char *text; // the data text, null for layers without data
+	    const char *encoding;
+	    const char *compression;
+	    unsigned char *data;
+	    unsigned int size;
+	    const char *error;
+	};
+
+	// decodes a share of the layers, one decoder is used
+	// for all of them so its inflate stream is only set up once
+	class LayerDecodeJob : public Job
+	{
+	public:
+	    void run()
+	    {
+	        for (unsigned int i = 0; i < layers.size(); ++i)
+	        {
+	            layers[i]->decode(decoder);
+	        }
+	    }
+
+	public:
+	    TileDecoder decoder;
+	    std::vector<PendingLayer*> layers;
+	};
+
+	int Map::loadLayers(TiXmlElement *e)
+	{
+	    std::vector<PendingLayer> layers;
+
+	    // read all the layers first, stopping at the first bad one
+	    for (e = e->FirstChildElement("layer"); e; e = e->NextSiblingElement("layer"))
+	    {
+	        PendingLayer layer;
+	        if (!layer.read(e))
+                break;
+	        layers.push_back(layer);
+	    }
+
+	    unsigned int decodeCount = 0;
+	    for (unsigned int i = 0; i < layers.size(); ++i)
+	    {
+	        if (layers[i].text)
+                ++decodeCount;
+	    }
+
+	    // decode them all at once, with a job for each thread
+	    // sharing out the layers. the pool finishes before its deleted
+	    if (decodeCount > 0)
+	    {
+	        unsigned int threads = std::min(ThreadPool::getCoreCount(), decodeCount);
+	        std::vector<LayerDecodeJob*> jobs;
+	        for (unsigned int i = 0; i < threads; ++i)
+	        {
+	            jobs.push_back(new LayerDecodeJob);
+	        }
+
+	        unsigned int next = 0;
+	        for (unsigned int i = 0; i < layers.size(); ++i)
+	        {
+	            if (!layers[i].text)
+                    continue;
+	            jobs[next]->layers.push_back(&layers[i]);
+	            next = (next + 1) % threads;
+	        }
+
+	        {
+	            ThreadPool pool(threads);
+	            for (unsigned int i = 0; i < jobs.size(); ++i)
+	            {
+	                pool.addJob(jobs[i]);
+	            }
+	            pool.wait();
+	        }
+
+	        for (unsigned int i = 0; i < jobs.size(); ++i)
+	        {
+	            delete jobs[i];
+	        }
+	    }
+
+	    // add them in the order they are in the file
+	    int numLayers = 0;
+	    unsigned int i = 0;
+	    for (; i < layers.size(); ++i)
+	    {
+	        PendingLayer &layer = layers[i];
+
+	        if (!layer.text)
+	        {
+	            Layer *l = new Layer(layer.name, layer.width, layer.height);
+	            mLayers.push_back(l);
+	            ++numLayers;
+	            continue;
+	        }
+
+	        if (layer.error)
+	        {
+	            logger->logError(layer.error);
+	            logger->logError("Unable to decode map data");
+	            break;
+	        }
+
+	        // the layer takes the data, so dont free it below
+	        unsigned char *data = layer.data;
+	        layer.data = NULL;
+
+	        if (!addLayer(layer.name, layer.width, layer.height, data, layer.size, true))
+                break;
+
+	        ++numLayers;
+	    }
+
+	    // free anything decoded after a layer failed
+	    for (; i < layers.size(); ++i)
+	    {
+	        free(layers[i].data);
+	    }
+
+	    return numLayers;
+	}
+
+	bool Map::loadBinaryMap(const std::string &filename, const std::string &source)
+	{
+	    std::string file = resourceManager->getDataPath(filename);
+        logger->logDebug("Loading map " + file);
+
+        // files inside a zip cant be mapped, so read those into memory
+        if (file.find(".zip") != std::string::npos)
+        {
+            // the layers read their tiles from the buffer, its freed on unload
+            int size = 0;
+            mMapBuffer = resourceManager->loadFile(filename, size);
+            if (!mMapBuffer)
+            {
+                logger->logError("Error loading map");
+                return false;
+            }
+
+            return loadBinaryData((unsigned char*) mMapBuffer, size, source);
+        }
+
+        // the file stays mapped until unload, the layers draw straight from it
+        if (!mMapFile.open(file))
         {
+            logger->logError("Error loading map");
             return false;
         }
 
-        int layerWidth, layerHeight;
-        std::string layerName;
+        return loadBinaryData(mMapFile.getData(), mMapFile.getSize(), source);
+	}
+
+	// reads a padded string from the map data, moving pos past it
+	static bool readMapString(const unsigned char *data, unsigned int size, unsigned int &pos,
+	                          std::string &str)
+	{
+	    if (size - pos < 4)
+	        return false;
+
+	    unsigned int length = readMapInt(data + pos);
+	    pos += 4;
+
+	    // check the length before padding it, padding a huge length wraps round
+	    if (length > size - pos || size - pos < paddedMapLength(length))
+	        return false;
+
+	    str.assign((const char*) data + pos, length);
+	    pos += paddedMapLength(length);
+
+	    return true;
+	}
+
+	bool Map::isUpToDate(const unsigned char *header, const std::string &source)
+	{
+	    // a .tmx that cant be read cant be checked against
+	    unsigned int sourceSize = 0;
+	    unsigned int sourceTime = 0;
+	    if (!resourceManager->getFileInfo(source, sourceSize, sourceTime))
+	        return true;
+
+	    if (readMapInt(header + 32) != sourceSize)
+	        return false;
+
+	    if (sourceTime && readMapInt(header + 36) == sourceTime)
+	        return true;
+
+	    // the time changes when its copied or checked out, so
+	    // only reading the whole file tells if the map has changed
+	    int size = 0;
+	    char *data = resourceManager->loadFile(source, size);
+	    if (!data)
+	        return true;
+
+	    bool unchanged = readMapInt(header + 40) ==
+	                     mapSourceChecksum((unsigned char*) data, size);
+	    free(data);
+
+	    return unchanged;
+	}
 
-        if (e->QueryIntAttribute("width", &layerWidth) != TIXML_SUCCESS)
+	bool Map::loadBinaryData(const unsigned char *data, unsigned int size,
+	                         const std::string &source)
+	{
+	    if (size < STMAP_HEADER_SIZE || readMapInt(data) != STMAP_MAGIC)
         {
-            logger->logError("No layer width");
+            logger->logError("Invalid binary map format");
             return false;
         }
 
-        if (e->QueryIntAttribute("height", &layerHeight) != TIXML_SUCCESS)
+        if (readMapInt(data + 4) != STMAP_VERSION)
         {
-            logger->logError("No layer height");
+            logger->logWarning("Binary map was compiled for a different version");
             return false;
-        }
-
-        // layer name is optional, needed for collision layer
-        layerName = e->Attribute("name");
-        if (layerName == "Character")
-        {
-            Layer *l = new Layer(layerName, layerWidth, layerHeight);
-            mLayers.push_back(l);
-            return true;
         }
 
-        // Load in compressed base64 map
-        e = e->FirstChild("data")->ToElement();
-        const char *data = e->GetText();
-        if (!data)
+        if (!source.empty() && !isUpToDate(data, source))
         {
-            logger->logError("No data");
+            logger->logWarning("Binary map is out of date, the map has changed since it was compiled");
             return false;
         }
 
-        // convert from base 64
-        int length = Base64::decodeSize(strlen(data));
-        unsigned char *compressedData = new unsigned char[length];
-        compressedData = Base64::decode(data, compressedData);
+        mWidth = readMapInt(data + 8);
+        mHeight = readMapInt(data + 12);
+        mTileWidth = readMapInt(data + 16);
+        mTileHeight = readMapInt(data + 20);
+        unsigned int numTilesets = readMapInt(data + 24);
+        unsigned int numLayers = readMapInt(data + 28);
 
-        if (length == 0)
+        if (numTilesets == 0)
         {
-            delete compressedData;
-            logger->logError("Unable to convert from base64");
+            logger->logError("No tilesets found.");
             return false;
         }
 
-        unsigned char *layerData;
+        if (numLayers == 0)
+        {
+            logger->logError("No layers found!");
+            return false;
+        }
 
-        unsigned int inflatedSize = Gzip::inflateMemory(compressedData, length, layerData);
+        // nothing blocks until the collision layer is loaded
+        mCollision.create(mWidth, mHeight);
 
-        delete compressedData;
+        unsigned int pos = STMAP_HEADER_SIZE;
+        std::string str;
 
-        if (inflatedSize == 0)
+        for (unsigned int i = 0; i < numTilesets; ++i)
         {
-            logger->logError("Unable to uncompress map data");
-            return false;
+            if (size - pos < 12)
+            {
+                logger->logError("Binary map is truncated");
+                return false;
+            }
+
+            int id = readMapInt(data + pos);
+            int width = readMapInt(data + pos + 4);
+            int height = readMapInt(data + pos + 8);
+            pos += 12;
+
+            if (!readMapString(data, size, pos, str))
+            {
+                logger->logError("Binary map is truncated");
+                return false;
+            }
+
+            if (id < 1 || id > MAX_TILE_ID)
+            {
+                logger->logError("Invalid tile id for tileset");
+                return false;
+            }
+
+            if (!addTileset(id, width, height, str))
+            {
+                return false;
+            }
         }
 
-        addLayer(layerName, layerWidth, layerHeight, layerData, inflatedSize);
+        for (unsigned int i = 0; i < numLayers; ++i)
+        {
+            if (!readMapString(data, size, pos, str) || size - pos < 12)
+            {
+                logger->logError("Binary map is truncated");
+                return false;
+            }
+
+            unsigned int width = readMapInt(data + pos);
+            unsigned int height = readMapInt(data + pos + 4);
+            unsigned int length = readMapInt(data + pos + 8);
+            pos += 12;
+
+            if (size - pos < length)
+            {
+                logger->logError("Binary map is truncated");
+                return false;
+            }
+
+            // layers without data are for characters to be added to
+            if (length == 0)
+            {
+                Layer *l = new Layer(str, width, height);
+                mLayers.push_back(l);
+                continue;
+            }
+
+            if (!addLayer(str, width, height, (unsigned char*) data + pos, length, false))
+            {
+                return false;
+            }
+            pos += length;
+        }
 
         return true;
 	}
 
-	void Map::addLayer(const std::string &name, unsigned int width, unsigned int height, unsigned char *data,
-		unsigned int len)
+	bool Map::addLayer(const std::string &name, unsigned int width, unsigned int height, unsigned char *data,
+		unsigned int len, bool owned)
     {
+        // compare without multiplying, the sizes come from the file
+        if (width && height && width > len / 4 / height)
+        {
+            logger->logError("Not enough data for layer " + name);
+            if (owned)
+                free(data);
+            return false;
+        }
+
         Layer *l = new Layer(name, width, height);
+        mLayers.push_back(l);
 
-        if (name == "collision")
-            l->setCollisionLayer();
-
-        // load in the layer data
-	    int length = len - 3;
-	    int x = 0;
-	    int y = 0;
-
-        for (int i = 0; i < length; i += 4)
-        {
-            // get the tile id by putting
-            // the data bytes into an integer
-            int tile_id = data[i] | data[i + 1] << 8 |
-                            data[i + 2] << 16 | data[i + 3] << 24;
-
-			if (tile_id > 0)
-			{
-				// search out the tileset the tile_id belongs to
-				for (size_t j = mTilesets.size()-1; j >= 0; --j)
-				{
-					// since we are searching backwards,
-					// we assume that the later tilesets
-					// have a greater tile_id, when tile_id
-					// is then greater, it means its part of the tileset
-					if (tile_id >= mTilesets[j]->id)
-					{
-						std::stringstream str;
-						str << mTilesets[j]->tilename << (tile_id - mTilesets[j]->id) + 1;
-						l->setTile(x, y, graphicsEngine->getTexture(str.str()), mTileWidth, mTileHeight);
-						break;
-					}
-				}
-			}
-            ++x;
-
-            // reached the end of the row
-            if (x == mWidth)
+        if (name != "collision")
+        {
+            // decoded data is packed by chunk and freed, compiled map
+            // data stays loaded so chunks are read straight from it
+            if (owned)
+            {
+                l->packTileData(data);
+                free(data);
+            }
+            else
             {
-                x = 0;
-                ++y;
+                l->setTileData(data);
+            }
+            return true;
+        }
+
+        // the collision layer is never drawn so only its bits are kept
+        l->setCollisionLayer();
 
-                // reached the end of the map
-                if (y == mHeight)
-                    break;
+        for (unsigned int y = 0; y < height; ++y)
+        {
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                const unsigned char *tile = data + (y * width + x) * 4;
+                if (tile[0] | tile[1] | tile[2] | tile[3])
+                    mCollision.setBlocked(x, y, true);
             }
         }
 
         // finished with the data now, free it
-        free(data);
+        if (owned)
+            free(data);
 
-        mLayers.push_back(l);
+        return true;
+    }
+
+    bool Map::getVisibleTiles(const Rectangle &view, Point &start, Point &end)
+    {
+        if (!mLoaded || mTileWidth == 0 || mTileHeight == 0)
+            return false;
+
+        // tiles are drawn right and up from their position,
+        // so look further left and down for any that reach into the view
+        int left = view.x - std::max(mMaxTileWidth, mTileWidth);
+        int right = view.x + (int)view.width;
+        int top = view.y;
+        int bottom = view.y + (int)view.height + std::max(mMaxTileHeight, mTileHeight);
+
+        // the view is a diamond in tile space, find the tiles at its corners
+        Point corners[4];
+        corners[0] = convertPixelToTile(left, top);
+        corners[1] = convertPixelToTile(right, top);
+        corners[2] = convertPixelToTile(left, bottom);
+        corners[3] = convertPixelToTile(right, bottom);
+
+        start = end = corners[0];
+        for (int i = 1; i < 4; ++i)
+        {
+            start.x = std::min(start.x, corners[i].x);
+            start.y = std::min(start.y, corners[i].y);
+            end.x = std::max(end.x, corners[i].x);
+            end.y = std::max(end.y, corners[i].y);
+        }
+
+        // converting to tiles rounds towards zero, so add one either side
+        start.x = std::max(start.x - 1, 0);
+        start.y = std::max(start.y - 1, 0);
+        end.x = std::min(end.x + 1, mWidth - 1);
+        end.y = std::min(end.y + 1, mHeight - 1);
+
+        return start.x <= end.x && start.y <= end.y;
+    }
+
+    void Map::setChunkRadius(int radius)
+    {
+        mChunkRadius = std::max(radius, 0);
+
+        // force the chunks to be checked again
+        mChunkStart.x = mChunkStart.y = -1;
+        mChunkEnd.x = mChunkEnd.y = -1;
+    }
+
+    void Map::updateChunks(const Rectangle &view)
+    {
+        Point first, last;
+        if (!getVisibleTiles(view, first, last))
+            return;
+
+        Point start, end;
+        start.x = std::max(first.x / Layer::CHUNK_SIZE - mChunkRadius, 0);
+        start.y = std::max(first.y / Layer::CHUNK_SIZE - mChunkRadius, 0);
+        end.x = std::min(last.x / Layer::CHUNK_SIZE + mChunkRadius, (mWidth - 1) / Layer::CHUNK_SIZE);
+        end.y = std::min(last.y / Layer::CHUNK_SIZE + mChunkRadius, (mHeight - 1) / Layer::CHUNK_SIZE);
+
+        if (start.x == mChunkStart.x && start.y == mChunkStart.y &&
+            end.x == mChunkEnd.x && end.y == mChunkEnd.y)
+            return;
+
+        mChunkStart = start;
+        mChunkEnd = end;
+
+        for (unsigned int i = 0; i < mLayers.size(); ++i)
+        {
+            Layer *layer = mLayers[i];
+            if (!layer->hasTileData())
+                continue;
+
+            for (unsigned int cy = 0; cy < layer->getChunksHigh(); ++cy)
+            {
+                for (unsigned int cx = 0; cx < layer->getChunksWide(); ++cx)
+                {
+                    // chunks are kept one further than they are loaded,
+                    // so walking along a chunk edge doesnt keep reloading them
+                    bool load = (int)cx >= start.x && (int)cx <= end.x &&
+                                (int)cy >= start.y && (int)cy <= end.y;
+                    bool keep = (int)cx >= start.x - 1 && (int)cx <= end.x + 1 &&
+                                (int)cy >= start.y - 1 && (int)cy <= end.y + 1;
+
+                    if (load)
+                        layer->loadTileChunk(cx, cy);
+                    else if (!keep)
+                        layer->unloadTileChunk(cx, cy);
+                }
+            }
+        }
     }
 
     Point Map::convertPixelToTile(int x, int y)
@@ -674,11 +1574,9 @@ namespace ST
 
     void Map::removeNode(Node *node)
     {
-        for (unsigned i = 0; i < mLayers.size(); ++i)
-        {
-            Layer *layer = getLayer(i);
+        Layer *layer = node->getLayerHandle().layer;
+        if (layer)
             layer->removeNode(node);
-        }
     }
 }
 
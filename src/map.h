@@ -44,6 +44,11 @@
 #include <string>
 #include <vector>
 
+#include "collisionmap.h"
+#include "flowfield.h"
+#include "hierarchicalpathfinder.h"
+#include "pathfinder.h"
+#include "utilities/mappedfile.h"
 #include "utilities/types.h"
 
 class TiXmlElement;
@@ -79,11 +84,23 @@ namespace ST
 
 	/**
 	 * The Layer class holds map layer data
+	 * Tiles are only stored as their ids and drawn straight from them,
+	 * nodes are used for things that move such as beings.
+	 * The ids are kept a chunk at a time, only the chunks
+	 * near the camera are decoded
 	 */
 	class Layer
 	{
     public:
         typedef std::vector<Node*>::iterator NodeItr;
+
+        // width and height in tiles of each chunk of tile ids,
+        // each part of the node index and each bucket of nodes to draw
+        enum { CHUNK_SIZE = 32 };
+
+        // removed slots are only compacted once there are this many
+        // and they are a quarter of the list, so removing stays cheap
+        enum { MIN_EMPTY_SLOTS = 32 };
 	public:
 		Layer(const std::string &name, unsigned int width, unsigned int height);
 		~Layer();
@@ -99,44 +116,132 @@ namespace ST
         bool isCollisionLayer() { return mCollisionLayer; }
 
         /**
-         * Set a tile
+         * Pack Tile Data
+         * Compresses the tile ids a chunk at a time,
+         * they are decoded again when the chunk is loaded
+         * @param data The tile ids, 4 bytes per tile, not needed afterwards
+         */
+        void packTileData(const unsigned char *data);
+
+        /**
+         * Set Tile Data
+         * Uses tile ids that stay in memory until the layer is deleted,
+         * such as a mapped file. Chunks are copied out of it when loaded
+         * @param data The tile ids, 4 bytes per tile
+         */
+        void setTileData(const unsigned char *data);
+
+        /**
+         * Has Tile Data
+         * Returns whether the layer has tiles to draw
+         */
+        bool hasTileData() const { return mHasTiles; }
+
+        /**
+         * Get Tile Id
+         * Returns the id of the tile at x, y,
+         * loading its chunk if it isnt loaded yet
+         */
+        int getTileId(unsigned int x, unsigned int y);
+
+        /**
+         * Get the number of chunks across and down the layer
          */
-        void setTile(int x, int y, Texture *tex, int width, int height);
+        unsigned int getChunksWide() const { return mChunksWide; }
+        unsigned int getChunksHigh() const { return mChunksHigh; }
+
+        /**
+         * Tile Chunk Loaded
+         * Returns whether the tile ids of a chunk are decoded
+         */
+        bool isTileChunkLoaded(unsigned int cx, unsigned int cy) const;
+
+        /**
+         * Load Tile Chunk
+         * Decodes the tile ids of a chunk so they can be drawn
+         */
+        void loadTileChunk(unsigned int cx, unsigned int cy);
+
+        /**
+         * Unload Tile Chunk
+         * Frees the decoded tile ids of a chunk,
+         * they can be loaded again from the packed ids
+         */
+        void unloadTileChunk(unsigned int cx, unsigned int cy);
 
 		/**
-		 * Add Tile
-		 * Adds a tile to the layer
-		 * @param tile The tile to add
+		 * Add Node
+		 * Adds a node to the layer, in drawing order
+		 * @param node The node to add
 		 */
 		void addNode(Node *node);
 
 		/**
 		 * Remove Node
-		 * Removes a node from the layer
+		 * Removes a node from the layer, keeping the others in drawing order.
+		 * Its slot is left empty until enough have been removed to compact
 		 * @param node The node to remove
 		 */
         void removeNode(Node *node);
 
 		/**
-		 * Get Tile At
-		 * Returns the tile at x, y
-		 * @param x The x position of the tile to return
-		 * @param y The y position of the tile to return
-		 * @return Returns the Tile found at the given location
+		 * Get Node At
+		 * Returns the node standing on tile x, y, if several are
+		 * on the same tile only the first to get there is found
+		 * @param x The x position of the tile
+		 * @param y The y position of the tile
+		 * @return Returns the Node found at the given location
 		 */
 		Node* getNodeAt(unsigned int x, unsigned int y);
 
+		/**
+		 * Update Node
+		 * Moves the node to its new place in drawing order, to the
+		 * bucket for its position and to its tile in the index,
+		 * call after it moves
+		 * @param node The node that moved
+		 */
+		void updateNode(Node *node);
+
+		/**
+		 * Get Nodes In Area
+		 * Adds the nodes in the buckets covering the tiles from start to
+		 * end to the list, along with any nodes outside the map.
+		 * Nodes near the edge of the area may not be inside it
+		 */
+		void getNodesInArea(const Point &start, const Point &end, std::vector<Node*> &nodes);
+
+		/**
+		 * Get Max Node Width
+		 * Returns the widest node added, including its anchor
+		 */
+		int getMaxNodeWidth() const { return mMaxNodeWidth; }
+
+		/**
+		 * Get Max Node Height
+		 * Returns the tallest node added
+		 */
+		int getMaxNodeHeight() const { return mMaxNodeHeight; }
+
         /**
          * Get Node iterator
+         * The list has empty slots left by removed nodes, skip any NULLs
          */
         NodeItr getFrontNode();
         NodeItr getEndNode();
 
         /**
          * Sort Nodes
+         * Puts all the nodes in drawing order, the layer keeps them
+         * in order as they change so this is rarely needed
          */
-        void sortNodes(int first, int size);
-        int findMiddleNode(int first, int size);
+        void sortNodes();
+
+        /**
+         * Compact Nodes
+         * Closes up the slots left by removed nodes, keeping them in order
+         */
+        void compactNodes();
 
         /**
          * Get Size
@@ -151,10 +256,96 @@ namespace ST
         const std::string& getName() const { return mName; }
 
     private:
-		std::vector<Node*> mNodes;
+        struct Chunk
+        {
+            Chunk();
+
+            Node *index[CHUNK_SIZE * CHUNK_SIZE]; // one slot per tile
+        };
+
+        struct TileChunk
+        {
+            TileChunk();
+
+            unsigned char *packed; // compressed ids, NULL if read from mTileData
+            unsigned int packedSize;
+            int *tiles; // decoded ids, NULL while not loaded
+            bool empty; // has no tiles, so there is nothing to decode
+        };
+
+        /**
+         * Get Chunk
+         * Returns the chunk holding tile x, y
+         * @param create Create the chunk if it doesnt exist yet
+         */
+        Chunk* getChunk(unsigned int x, unsigned int y, bool create);
+
+        /**
+         * Index Node
+         * Stores the node in the tile index if that tile is free
+         */
+        void indexNode(Node *node, unsigned int x, unsigned int y);
+
+        /**
+         * Unindex Node
+         * Clears the node from the tile it was indexed at
+         */
+        void unindexNode(Node *node);
+
+        /**
+         * Get Bucket
+         * Returns the bucket for the node's tile, the last bucket
+         * holds nodes outside the map
+         */
+        int getBucket(Node *node);
+
+        /**
+         * Add To Bucket
+         * Puts the node at the end of a bucket
+         */
+        void addToBucket(Node *node, int bucket);
+
+        /**
+         * Remove From Bucket
+         * Takes the node out of its bucket, the last node takes its place
+         */
+        void removeFromBucket(Node *node);
+
+        /**
+         * Reorder Node
+         * Moves the node along the list until it is in drawing order again,
+         * so only costs as much as how far its depth changed
+         */
+        void reorderNode(Node *node);
+
+        /**
+         * Get Depth
+         * Returns the value nodes are put in drawing order by
+         */
+        static int getDepth(Node *node);
+
+        /**
+         * Sort Nodes
+         * Sorts size nodes from first, the slots are updated by sortNodes()
+         */
+        void sortNodes(int first, int size);
+        int findMiddleNode(int first, int size);
+
+    private:
+		std::vector<Node*> mNodes; // NULL where a node was removed
+		unsigned int mEmptySlots;
+		std::vector<Chunk*> mChunks; // created when first used
+		std::vector<std::vector<Node*> > mBuckets; // nodes by chunk, to find those on screen
+		std::vector<TileChunk> mTileChunks; // same order as mChunks
+		const unsigned char *mTileData; // ids read in place, not owned
+		bool mHasTiles;
 		std::string mName;
 		unsigned int mWidth;
 		unsigned int mHeight;
+		unsigned int mChunksWide;
+		unsigned int mChunksHigh;
+		int mMaxNodeWidth;
+		int mMaxNodeHeight;
 		bool mCollisionLayer;
 	};
 
@@ -233,28 +424,28 @@ namespace ST
         Point walkMap(const Point &pos, int dir);
 
         /**
-         * Return tile in direction
+         * Return tile id in direction
          * @param pos The tile position
          * @param dir The direction from that position
-         * @return Returns the node at that position + direction
+         * @return Returns the ground tile id at that position + direction
          */
-        Node* getTile(const Point &pos, int dir);
+        int getTileId(const Point &pos, int dir);
 
         /**
-         * Return map tile
+         * Return map tile id
          * @param pos The world pixel position of the tile
-         * @return Returns the node at that position
+         * @return Returns the ground tile id at that position, 0 if none
          */
-        Node* getTile(const Point &pos);
+        int getTileId(const Point &pos);
 
         /**
-         * Return map tile
+         * Return map tile id
          * @param x The tile x position
          * @param y The tile y position
          * @param layer The layer of the tile
-         * @return Returns the node at that position
+         * @return Returns the tile id at that position, 0 if none
          */
-        Node* getTile(int x, int y, unsigned int layer);
+        int getTileId(int x, int y, unsigned int layer);
 
         /**
          * Return tile position
@@ -285,6 +476,61 @@ namespace ST
          */
         bool blocked(const Point &pos);
 
+        /**
+         * Return the collision data
+         * Use this to check whole rows or areas of tiles at once
+         */
+        const CollisionMap& getCollisionMap() const { return mCollision; }
+
+        /**
+         * Get Visible Tiles
+         * Finds the tiles that could be seen in a view,
+         * allowing for tiles taller or wider than the map tiles
+         * @param view The area of the map being shown in pixels
+         * @param start Set to the first tile that could be seen
+         * @param end Set to the last tile that could be seen
+         * @return Returns false if no tiles can be seen
+         */
+        bool getVisibleTiles(const Rectangle &view, Point &start, Point &end);
+
+        /**
+         * Set Chunk Radius
+         * Sets how many chunks around the view stay loaded
+         * @param radius The number of chunks
+         */
+        void setChunkRadius(int radius);
+
+        /**
+         * Update Chunks
+         * Decodes the tile ids of chunks near the view and
+         * frees those that have gone too far outside it
+         * @param view The area of the map being shown in pixels
+         */
+        void updateChunks(const Rectangle &view);
+
+        /**
+         * Get Tile Texture.
+         * Returns the texture for a tile id
+         */
+        Texture* getTileTexture(int id)
+        {
+            if (id <= 0 || id >= (int)mTileTextures.size())
+                return NULL;
+            return mTileTextures[id];
+        }
+
+        /**
+         * Find Path
+         * Finds the shortest walkable route between two tiles,
+         * long routes on big maps are found through clusters, and on
+         * small maps popular destinations share a cached flow field
+         * @param start The tile position to start from
+         * @param end The tile position to finish on
+         * @param path Filled with each tile to walk through, not including start
+         * @return Returns whether a path was found
+         */
+        bool findPath(const Point &start, const Point &end, std::vector<Point> &path);
+
         /**
          * Remove a node
          * Removes the node from the map
@@ -295,9 +541,48 @@ namespace ST
 		/**
 		 * Add Layer.
 		 * Adds a layer to the map
+		 * @param owned Whether the map should free the data when finished with it
+		 * @return Returns whether it succeeded
 		 */
-        void addLayer(const std::string &name, unsigned int width, unsigned int height, unsigned char *data,
-			unsigned int len);
+        bool addLayer(const std::string &name, unsigned int width, unsigned int height, unsigned char *data,
+			unsigned int len, bool owned);
+
+        /**
+         * Add Tileset.
+         * Loads the images for a tileset and adds it to the map
+         * @return Returns whether it succeeded
+         */
+        bool addTileset(int id, int width, int height, const std::string &source);
+
+        /**
+         * Load Binary Map.
+         * Reads a map compiled by the map compiler
+         * @param filename The name of the .stmap file
+         * @param source The .tmx it was compiled from, empty if there isnt one
+         * @return Returns whether it succeeded, false if it is out of date
+         */
+        bool loadBinaryMap(const std::string &filename, const std::string &source);
+
+        /**
+         * Load Binary Data.
+         * Creates the map from compiled map data
+         * @param data The contents of the .stmap file
+         * @param size The size of the data in bytes
+         * @param source The .tmx it was compiled from, empty if there isnt one
+         * @return Returns whether it succeeded
+         */
+        bool loadBinaryData(const unsigned char *data, unsigned int size,
+                            const std::string &source);
+
+        /**
+         * Is Up To Date
+         * Checks the .tmx hasnt changed since the map was compiled,
+         * only reading it when its time has changed but not its size
+         * @param header The header of the .stmap file
+         * @param source The .tmx it was compiled from
+         * @return Returns false if the .tmx has changed
+         */
+        bool isUpToDate(const unsigned char *header, const std::string &source);
 
         /**
          * Load Map Info from xml file.
@@ -314,16 +599,34 @@ namespace ST
         bool loadTileset(TiXmlElement *e);
 
         /**
-         * Load Layer from xml file.
-         * Load in data for layer
-         * @return Returns whether it succeeded
+         * Load Layers from xml file.
+         * Decodes the data of every layer at the same time on a thread pool,
+         * then adds them in the order they appear in the file
+         * @param e The map element
+         * @return Returns the number of layers added
          */
-        bool loadLayer(TiXmlElement *e);
+        int loadLayers(TiXmlElement *e);
 
 	private:
+        // largest first tile id a tileset can have, the tile
+        // textures are stored in a table that goes up to it
+        enum { MAX_TILE_ID = 65536 };
+
 		std::vector<Layer*> mLayers;
 		typedef std::vector<Layer*>::iterator LayerItr;
 		std::vector<Tileset*> mTilesets;
+		std::vector<Texture*> mTileTextures; // indexed by tile id
+        CollisionMap mCollision;
+        Pathfinder mPathfinder;
+        HierarchicalPathfinder mHierarchicalPathfinder;
+        FlowFieldCache mFlowFields;
+        MappedFile mMapFile;
+        char *mMapBuffer;
+        int mMaxTileWidth; // largest tiles of the tilesets
+        int mMaxTileHeight;
+        Point mChunkStart; // the chunks last loaded
+        Point mChunkEnd;
+        int mChunkRadius;
         Point mTileWalk[8];
 		int mWidth;
 		int mHeight;
@@ -0,0 +1,100 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * Layout of the compiled binary map files (.stmap)
+ *
+ * Every value is a 32 bit little endian unsigned integer.
+ * Strings are stored as a length followed by the characters,
+ * padded with zeros to a multiple of 4 bytes.
+ *
+ * Header:  magic, version, width, height, tile width, tile height,
+ *          number of tilesets, number of layers,
+ *          size, modification time and checksum of the .tmx
+ *          it was compiled from
+ * Tileset: first gid, tile width, tile height, image source
+ * Layer:   name, width, height, data length in bytes, tile gids
+ *
+ * The tile gids are stored the same as the inflated tmx layer data,
+ * so they can be passed straight to Map::addLayer.
+ */
+
+#ifndef ST_MAPFORMAT_HEADER
+#define ST_MAPFORMAT_HEADER
+
+#include <zlib.h>
+
+namespace ST
+{
+	// "STMP" read as a little endian integer
+	const unsigned int STMAP_MAGIC = 0x504D5453;
+
+	// increase this whenever the layout changes,
+	// maps compiled with other versions will be ignored
+	const unsigned int STMAP_VERSION = 3;
+
+	const unsigned int STMAP_HEADER_SIZE = 44;
+
+	/**
+	 * Read an integer from the map data
+	 */
+	inline unsigned int readMapInt(const unsigned char *data)
+	{
+		return data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24;
+	}
+
+	/**
+	 * Size of a string once padded
+	 */
+	inline unsigned int paddedMapLength(unsigned int length)
+	{
+		return (length + 3) & ~3u;
+	}
+
+	/**
+	 * Checksum of the .tmx file, so a compiled map can tell when its
+	 * source has changed even though its modification time has
+	 */
+	inline unsigned int mapSourceChecksum(const unsigned char *data, unsigned int size)
+	{
+		return crc32(crc32(0L, Z_NULL, 0), data, size);
+	}
+}
+
+#endif
@@ -402,7 +402,6 @@ namespace ST
                 c->moveNode(&pos);
 
                 graphicsEngine->warpCamera(pos);
-                graphicsEngine->sort();
             } break;
 
         case GPMSG_PLAYER_MOVE:
@@ -480,7 +479,7 @@ namespace ST
                     Point pos = mapEngine->convertTileToPixel(pt);
                     int dir = beingManager->getSavedDirection(id);
 
-                    Texture *avatar = graphicsEngine->createAvatar(id, Ids, DIRECTION_SOUTHEAST);
+                    Texture *avatar = graphicsEngine->createBeingTexture(id, Ids, DIRECTION_SOUTHEAST);
                     Character *c = new Character(id, name, avatar);
                     c->look.body = Ids[PART_BODY];
                     c->look.hair = Ids[PART_HAIR];
@@ -494,7 +493,6 @@ namespace ST
 
                     beingManager->addBeing(c);
                     mapEngine->getLayer(mapEngine->getLayers() - 1)->addNode(c);
-                    graphicsEngine->sort();
 
                     std::stringstream str;
                     str << "New player info from id " << id << " received";
@@ -516,7 +514,6 @@ namespace ST
                 {
                     mapEngine->getLayer(mapEngine->getLayers() - 1)->removeNode(being);
                     beingManager->removeBeing(id);
-                    graphicsEngine->sort();
                 }
 				logger->logDebug("Player Left");
             } break;
@@ -548,7 +545,6 @@ namespace ST
 
                 beingManager->addBeing(c);
                 mapEngine->getLayer(mapEngine->getLayers() - 1)->addNode(c);
-                graphicsEngine->sort();
 
                 std::stringstream str;
                 str << "NPC found at " << pos.x << "x" << pos.y;
@@ -0,0 +1,399 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "pathfinder.h"
+#include "collisionmap.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace ST
+{
+    static int sign(int value)
+    {
+        return (value > 0) - (value < 0);
+    }
+
+    // cost of moving between two tiles with nothing in the way
+    static unsigned int octile(int dx, int dy)
+    {
+        dx = abs(dx);
+        dy = abs(dy);
+        if (dx < dy)
+            std::swap(dx, dy);
+        return Pathfinder::DIAGONAL_COST * dy + Pathfinder::STRAIGHT_COST * (dx - dy);
+    }
+
+	Pathfinder::Pathfinder() :
+        mMap(NULL),
+        mGeneration(0),
+        mExpanded(0),
+        mWidth(0),
+        mHeight(0)
+	{
+
+	}
+
+	bool Pathfinder::findPath(const CollisionMap &map, const Point &start, const Point &end,
+                              std::vector<Point> &path, bool jumpPoints)
+	{
+        path.clear();
+
+        if (map.blocked(end.x, end.y))
+            return false;
+
+        // the start is allowed to be blocked, a being could be standing there
+        if (start.x < 0 || start.y < 0 ||
+            start.x >= (int)map.getWidth() || start.y >= (int)map.getHeight())
+            return false;
+
+        if (start.x == end.x && start.y == end.y)
+            return true;
+
+        reset(map);
+        mStart = start;
+        mEnd = end;
+
+        open(start.x, start.y, 0, -1);
+
+        int endIndex = end.y * mWidth + end.x;
+
+        while (!mOpen.empty())
+        {
+            std::pop_heap(mOpen.begin(), mOpen.end());
+            OpenEntry entry = mOpen.back();
+            mOpen.pop_back();
+
+            SearchNode &node = mNodes[entry.index];
+
+            // old entry for a tile that was since reached a cheaper way
+            if (node.closed || entry.g != node.g)
+                continue;
+
+            node.closed = true;
+            ++mExpanded;
+
+            if (entry.index == endIndex)
+            {
+                buildPath(endIndex, path);
+                return true;
+            }
+
+            int x = entry.index % mWidth;
+            int y = entry.index / mWidth;
+
+            if (jumpPoints)
+                expandJumpPoints(x, y, entry.g, entry.index);
+            else
+                expandAStar(x, y, entry.g, entry.index);
+        }
+
+        return false;
+	}
+
+	void Pathfinder::reset(const CollisionMap &map)
+	{
+        mMap = &map;
+        mExpanded = 0;
+        mOpen.clear();
+
+        // nodes are only cleared when the map size changes,
+        // otherwise the generation tells which ones are stale
+        if (mWidth != (int)map.getWidth() || mHeight != (int)map.getHeight())
+        {
+            mWidth = map.getWidth();
+            mHeight = map.getHeight();
+            mNodes.clear();
+            mNodes.resize(mWidth * mHeight);
+            mGeneration = 0;
+        }
+
+        ++mGeneration;
+
+        // wrapped around, old generations could match again
+        if (mGeneration == 0)
+        {
+            for (unsigned int i = 0; i < mNodes.size(); ++i)
+                mNodes[i].generation = 0;
+            mGeneration = 1;
+        }
+	}
+
+	void Pathfinder::open(int x, int y, unsigned int g, int parent)
+	{
+        int index = y * mWidth + x;
+        SearchNode &node = mNodes[index];
+
+        if (node.generation == mGeneration)
+        {
+            if (node.closed || node.g <= g)
+                return;
+        }
+        else
+        {
+            node.generation = mGeneration;
+            node.closed = false;
+        }
+
+        node.g = g;
+        node.parent = parent;
+
+        OpenEntry entry;
+        entry.g = g;
+        entry.f = g + heuristic(x, y);
+        entry.index = index;
+        mOpen.push_back(entry);
+        std::push_heap(mOpen.begin(), mOpen.end());
+	}
+
+	void Pathfinder::expandAStar(int x, int y, unsigned int g, int index)
+	{
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                if (dx == 0 && dy == 0)
+                    continue;
+
+                if (!walkable(x + dx, y + dy))
+                    continue;
+
+                if (dx && dy)
+                {
+                    if (!walkable(x + dx, y) || !walkable(x, y + dy))
+                        continue;
+                    open(x + dx, y + dy, g + DIAGONAL_COST, index);
+                }
+                else
+                {
+                    open(x + dx, y + dy, g + STRAIGHT_COST, index);
+                }
+            }
+        }
+	}
+
+	void Pathfinder::expandJumpPoints(int x, int y, unsigned int g, int index)
+	{
+        int dirs[8][2];
+        int numDirs = 0;
+        int parent = mNodes[index].parent;
+
+        if (parent < 0)
+        {
+            // the start tile searches every direction
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx || dy)
+                    {
+                        dirs[numDirs][0] = dx;
+                        dirs[numDirs][1] = dy;
+                        ++numDirs;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // only search the natural and forced neighbours
+            // based on the direction we came from
+            int dx = sign(x - parent % mWidth);
+            int dy = sign(y - parent / mWidth);
+
+            if (dx && dy)
+            {
+                dirs[numDirs][0] = 0; dirs[numDirs][1] = dy; ++numDirs;
+                dirs[numDirs][0] = dx; dirs[numDirs][1] = 0; ++numDirs;
+                dirs[numDirs][0] = dx; dirs[numDirs][1] = dy; ++numDirs;
+            }
+            else if (dx)
+            {
+                dirs[numDirs][0] = dx; dirs[numDirs][1] = 0; ++numDirs;
+                dirs[numDirs][0] = dx; dirs[numDirs][1] = 1; ++numDirs;
+                dirs[numDirs][0] = dx; dirs[numDirs][1] = -1; ++numDirs;
+                dirs[numDirs][0] = 0; dirs[numDirs][1] = 1; ++numDirs;
+                dirs[numDirs][0] = 0; dirs[numDirs][1] = -1; ++numDirs;
+            }
+            else
+            {
+                dirs[numDirs][0] = 0; dirs[numDirs][1] = dy; ++numDirs;
+                dirs[numDirs][0] = 1; dirs[numDirs][1] = dy; ++numDirs;
+                dirs[numDirs][0] = -1; dirs[numDirs][1] = dy; ++numDirs;
+                dirs[numDirs][0] = 1; dirs[numDirs][1] = 0; ++numDirs;
+                dirs[numDirs][0] = -1; dirs[numDirs][1] = 0; ++numDirs;
+            }
+        }
+
+        for (int i = 0; i < numDirs; ++i)
+        {
+            int dx = dirs[i][0];
+            int dy = dirs[i][1];
+
+            if (!walkable(x + dx, y + dy))
+                continue;
+
+            if (dx && dy && (!walkable(x + dx, y) || !walkable(x, y + dy)))
+                continue;
+
+            int jx, jy;
+            if (jump(x + dx, y + dy, dx, dy, jx, jy))
+            {
+                open(jx, jy, g + octile(jx - x, jy - y), index);
+            }
+        }
+	}
+
+	bool Pathfinder::jumpStraight(int x, int y, int dx, int dy, int &jx, int &jy) const
+	{
+        while (walkable(x, y))
+        {
+            if (x == mEnd.x && y == mEnd.y)
+            {
+                jx = x;
+                jy = y;
+                return true;
+            }
+
+            // a blocked tile behind and to the side means a
+            // new route opens up here, so stop and search from it
+            if (dx)
+            {
+                if ((walkable(x, y - 1) && !walkable(x - dx, y - 1)) ||
+                    (walkable(x, y + 1) && !walkable(x - dx, y + 1)))
+                {
+                    jx = x;
+                    jy = y;
+                    return true;
+                }
+            }
+            else
+            {
+                if ((walkable(x - 1, y) && !walkable(x - 1, y - dy)) ||
+                    (walkable(x + 1, y) && !walkable(x + 1, y - dy)))
+                {
+                    jx = x;
+                    jy = y;
+                    return true;
+                }
+            }
+
+            x += dx;
+            y += dy;
+        }
+
+        return false;
+	}
+
+	bool Pathfinder::jump(int x, int y, int dx, int dy, int &jx, int &jy) const
+	{
+        if (!dx || !dy)
+            return jumpStraight(x, y, dx, dy, jx, jy);
+
+        while (walkable(x, y))
+        {
+            if (x == mEnd.x && y == mEnd.y)
+            {
+                jx = x;
+                jy = y;
+                return true;
+            }
+
+            // stop if either straight direction finds something
+            int sx, sy;
+            if (jumpStraight(x + dx, y, dx, 0, sx, sy) ||
+                jumpStraight(x, y + dy, 0, dy, sx, sy))
+            {
+                jx = x;
+                jy = y;
+                return true;
+            }
+
+            // cannot squeeze diagonally between two blocked tiles
+            if (!walkable(x + dx, y) || !walkable(x, y + dy))
+                return false;
+
+            x += dx;
+            y += dy;
+        }
+
+        return false;
+	}
+
+	bool Pathfinder::walkable(int x, int y) const
+	{
+        return !mMap->blocked(x, y);
+	}
+
+	unsigned int Pathfinder::heuristic(int x, int y) const
+	{
+        return octile(mEnd.x - x, mEnd.y - y);
+	}
+
+	void Pathfinder::buildPath(int index, std::vector<Point> &path) const
+	{
+        // collect the jump points from the end back to the start
+        std::vector<int> points;
+        while (index >= 0)
+        {
+            points.push_back(index);
+            index = mNodes[index].parent;
+        }
+
+        // fill in every tile between each jump point, they are always
+        // in a straight or diagonal line from each other
+        for (int i = (int)points.size() - 1; i > 0; --i)
+        {
+            Point pt;
+            pt.x = points[i] % mWidth;
+            pt.y = points[i] / mWidth;
+            int nextX = points[i - 1] % mWidth;
+            int nextY = points[i - 1] / mWidth;
+            int dx = sign(nextX - pt.x);
+            int dy = sign(nextY - pt.y);
+
+            while (pt.x != nextX || pt.y != nextY)
+            {
+                pt.x += dx;
+                pt.y += dy;
+                path.push_back(pt);
+            }
+        }
+	}
+}
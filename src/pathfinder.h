@@ -0,0 +1,153 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The Pathfinder class finds routes across the collision data of the map
+ */
+
+#ifndef ST_PATHFINDER_HEADER
+#define ST_PATHFINDER_HEADER
+
+#include <vector>
+
+#include "utilities/types.h"
+
+namespace ST
+{
+    class CollisionMap;
+
+	class Pathfinder
+	{
+	public:
+	    // costs of moving one tile, roughly 10 * sqrt(2) for diagonals
+	    enum { STRAIGHT_COST = 10, DIAGONAL_COST = 14 };
+
+	public:
+		Pathfinder();
+
+		/**
+		 * Find Path
+		 * Searches for the shortest route between two tiles, moving in
+		 * any of the 8 directions. Diagonal steps are only taken when
+		 * both tiles beside the step are free, so corners are not cut.
+		 * @param map The collision data to search
+		 * @param start The tile to start from
+		 * @param end The tile to finish on
+		 * @param path Filled with every tile stepped on, not including start
+		 * @param jumpPoints Use jump point search, skipping over open areas
+		 * @return Returns whether a path was found
+		 */
+        bool findPath(const CollisionMap &map, const Point &start, const Point &end,
+                      std::vector<Point> &path, bool jumpPoints = true);
+
+        /**
+         * Get Expanded
+         * @return Returns the number of tiles expanded by the last search
+         */
+        unsigned int getExpanded() const { return mExpanded; }
+
+	private:
+        struct SearchNode
+        {
+            unsigned int g;
+            int parent;
+            unsigned int generation; // search the node belongs to
+            bool closed;
+        };
+
+        struct OpenEntry
+        {
+            unsigned int f;
+            unsigned int g;
+            int index;
+
+            // reversed so the heap returns the lowest cost first
+            bool operator<(const OpenEntry &other) const
+            {
+                if (f != other.f)
+                    return f > other.f;
+                return g < other.g;
+            }
+        };
+
+        /**
+         * Prepare the pooled lists for a new search
+         */
+        void reset(const CollisionMap &map);
+
+        /**
+         * Add tile to the open list if its a cheaper way of getting there
+         */
+        void open(int x, int y, unsigned int g, int parent);
+
+        /**
+         * Add the neighbours worth searching from a tile
+         */
+        void expandAStar(int x, int y, unsigned int g, int index);
+        void expandJumpPoints(int x, int y, unsigned int g, int index);
+
+        /**
+         * Jump from a tile in a direction until something interesting is found
+         * @return Returns whether a jump point was found, stored in jx, jy
+         */
+        bool jump(int x, int y, int dx, int dy, int &jx, int &jy) const;
+        bool jumpStraight(int x, int y, int dx, int dy, int &jx, int &jy) const;
+
+        bool walkable(int x, int y) const;
+        unsigned int heuristic(int x, int y) const;
+
+        /**
+         * Walk back from the end building the list of tiles
+         */
+        void buildPath(int index, std::vector<Point> &path) const;
+
+	private:
+        const CollisionMap *mMap;
+        std::vector<SearchNode> mNodes;
+        std::vector<OpenEntry> mOpen;
+        unsigned int mGeneration;
+        unsigned int mExpanded;
+        int mWidth;
+        int mHeight;
+        Point mStart;
+        Point mEnd;
+	};
+}
+
+#endif
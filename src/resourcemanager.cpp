@@ -483,6 +483,22 @@ namespace ST
         return buffer;
     }
 
+    bool ResourceManager::getFileInfo(const std::string &filename, unsigned int &size,
+                                      unsigned int &modified)
+    {
+        PHYSFS_file *file = PHYSFS_openRead(filename.c_str());
+        if (file == NULL || filename.empty())
+            return false;
+
+        size = PHYSFS_fileLength(file);
+        PHYSFS_close(file);
+
+        PHYSFS_sint64 time = PHYSFS_getLastModTime(filename.c_str());
+        modified = (time == -1) ? 0 : (unsigned int) time;
+
+        return true;
+    }
+
     void ResourceManager::loadGlowingTiles()
     {
         int size = 0;
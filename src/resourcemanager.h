@@ -138,6 +138,15 @@ namespace ST
         char* loadFile(const std::string &filename, int &size);
 
         /**
+         * Get File Info
+         * Finds the size and modification time of a file without reading it
+         * @param modified Set to 0 when the time isnt known
+         * @return Returns false if the file cant be opened
+         */
+        bool getFileInfo(const std::string &filename, unsigned int &size,
+                         unsigned int &modified);
+
+        /**
          * Load glowing tiles
          */
         void loadGlowingTiles();
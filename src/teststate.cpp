@@ -165,40 +165,38 @@ namespace ST
         // left mouse button has finished being pressed
         if (evt->button == SDL_BUTTON_LEFT && evt->type == 1)
         {
-            // check user clicked on map
+            // show name if player/NPC is clicked
             Node *node = graphicsEngine->getNode(pos.x, pos.y);
-            if (node)
+            Being *being = node ? beingManager->findBeing(node->getName()) : NULL;
+            if (being)
             {
-                // show name if player/NPC is clicked
-                Being *being = beingManager->findBeing(node->getName());
-                if (being)
+                // toggle being name
+                being->toggleName();
+                if (being->isNPC() && withinReach(being->getPosition(), player->getSelectedCharacter()->getPosition()) && !being->isTalking())
                 {
-                    // toggle being name
-                    being->toggleName();
-                    if (being->isNPC() && withinReach(being->getPosition(), player->getSelectedCharacter()->getPosition()) && !being->isTalking())
-                    {
-                        Packet *p = new Packet(PGMSG_NPC_START_TALK);
-                        p->setInteger(being->getId());
-                        networkManager->sendPacket(p);
-                    }
-                    return;
+                    Packet *p = new Packet(PGMSG_NPC_START_TALK);
+                    p->setInteger(being->getId());
+                    networkManager->sendPacket(p);
                 }
+                return;
+            }
 
-                Point pt = mapEngine->convertPixelToTile(pos.x, pos.y);
+            // tiles arent nodes, so check the tile clicked on instead,
+            // tiles off the map are always blocked
+            Point pt = mapEngine->convertPixelToTile(pos.x, pos.y);
 
-                if (mapEngine->blocked(pt))
-                    return;
+            if (mapEngine->blocked(pt))
+                return;
 
-                // send move message
-                Packet *p = new Packet(PGMSG_PLAYER_MOVE);
-                p->setInteger(pt.x);
-                p->setInteger(pt.y);
-                networkManager->sendPacket(p);
-                //logger->logDebug("Sending move request");
+            // send move message
+            Packet *p = new Packet(PGMSG_PLAYER_MOVE);
+            p->setInteger(pt.x);
+            p->setInteger(pt.y);
+            networkManager->sendPacket(p);
+            //logger->logDebug("Sending move request");
 
-                // save destination for later
-                player->getSelectedCharacter()->saveDestination(pt);
-            }
+            // save destination for later
+            player->getSelectedCharacter()->saveDestination(pt);
         }
 
 		if (evt->button == 0)
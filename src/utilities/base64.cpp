@@ -102,6 +102,43 @@ namespace ST
         return outStr;
     }
 
+    int Base64::decodePart(const char *&inStr, unsigned char *outStr, int outSize)
+    {
+        int n = 0;
+
+        // each group of 4 characters is at most 3 bytes
+        while (*inStr && outSize - n >= 3)
+        {
+            int shift = 0;
+            int accum = 0;
+            int chars = 0;
+
+            while (*inStr && chars < 4)
+            {
+                int value = decode_value(*inStr);
+                ++inStr;
+
+                // skip new lines and padding
+                if (value < 0)
+                    continue;
+
+                accum <<= 6;
+                shift += 6;
+                accum |= value;
+                ++chars;
+
+                if (shift >= 8)
+                {
+                    shift -= 8;
+                    outStr[n] = (char)((accum >> shift) & 0xFF);
+                    ++n;
+                }
+            }
+        }
+
+        return n;
+    }
+
     int Base64::decodeSize(int stringSize)
     {
         // get the length
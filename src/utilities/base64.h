@@ -53,6 +53,17 @@ namespace ST
     public:
         static unsigned char* decode(const char *inStr, unsigned char *outStr);
         static int decodeSize(int stringSize);
+
+        /**
+         * Decode Part
+         * Decodes as many whole groups of 4 characters as fit in outStr,
+         * so long strings can be decoded without a buffer for all of it
+         * @param inStr The string to decode, moved past what was decoded
+         * @param outStr Where to put the decoded bytes
+         * @param outSize The size of outStr
+         * @return Returns the number of bytes put in outStr, 0 at the end
+         */
+        static int decodePart(const char *&inStr, unsigned char *outStr, int outSize);
 	};
 }
 
@@ -96,22 +96,7 @@ namespace ST
 
         if (ret != Z_OK || out == NULL)
         {
-            if (ret == Z_MEM_ERROR)
-            {
-                logger->logError("Error: Out of memory while decompressing map data!");
-            }
-            else if (ret == Z_VERSION_ERROR)
-            {
-                logger->logError("Error: Incompatible zlib version!");
-            }
-            else if (ret == Z_DATA_ERROR)
-            {
-                logger->logError("Error: Incorrect zlib compressed data!");
-            }
-            else
-            {
-                logger->logError("Error: Unknown error while decompressing map data!");
-            }
+            logger->logError(getErrorString(ret));
 
             free(out);
             out = NULL;
@@ -120,4 +105,19 @@ namespace ST
 
         return outLength;
     }
+
+    const char* Gzip::getErrorString(int error)
+    {
+        switch (error)
+        {
+            case Z_MEM_ERROR:
+                return "Error: Out of memory while decompressing map data!";
+            case Z_VERSION_ERROR:
+                return "Error: Incompatible zlib version!";
+            case Z_DATA_ERROR:
+                return "Error: Incorrect zlib compressed data!";
+            default:
+                return "Error: Unknown error while decompressing map data!";
+        }
+    }
 }
@@ -55,6 +55,11 @@ namespace ST
                       unsigned char *&out, unsigned int &outLength);
         static int inflateMemory(unsigned char *in, unsigned int inLength,
                       unsigned char *&out);
+
+        /**
+         * Returns the message to log for an error from inflateMemory
+         */
+        static const char* getErrorString(int error);
 	};
 }
 
@@ -0,0 +1,166 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ST
+{
+	MappedFile::MappedFile() :
+		mData(NULL),
+		mSize(0),
+#ifdef _WIN32
+		mFile(INVALID_HANDLE_VALUE),
+		mMapping(NULL)
+#else
+		mFile(-1)
+#endif
+	{
+
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const std::string &filename)
+	{
+		close();
+
+		mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+							OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mFile == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		DWORD size = GetFileSize(mFile, NULL);
+		if (size == INVALID_FILE_SIZE || size == 0)
+		{
+			close();
+			return false;
+		}
+
+		mMapping = CreateFileMapping(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mMapping == NULL)
+		{
+			close();
+			return false;
+		}
+
+		mData = (const unsigned char*) MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mData == NULL)
+		{
+			close();
+			return false;
+		}
+
+		mSize = size;
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (mData)
+			UnmapViewOfFile(mData);
+		if (mMapping)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mFile);
+
+		mData = NULL;
+		mSize = 0;
+		mMapping = NULL;
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	bool MappedFile::open(const std::string &filename)
+	{
+		close();
+
+		mFile = ::open(filename.c_str(), O_RDONLY);
+		if (mFile < 0)
+		{
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(mFile, &info) != 0 || info.st_size == 0)
+		{
+			close();
+			return false;
+		}
+
+		void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+		if (data == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		mData = (const unsigned char*) data;
+		mSize = info.st_size;
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (mData)
+			munmap((void*) mData, mSize);
+		if (mFile >= 0)
+			::close(mFile);
+
+		mData = NULL;
+		mSize = 0;
+		mFile = -1;
+	}
+#endif
+}
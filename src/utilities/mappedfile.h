@@ -0,0 +1,100 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The MappedFile class maps a file into memory for reading
+ */
+
+#ifndef ST_MAPPEDFILE_HEADER
+#define ST_MAPPEDFILE_HEADER
+
+#include <string>
+
+namespace ST
+{
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		/**
+		 * Open
+		 * Maps the whole file read only
+		 * @param filename The full path to the file
+		 * @return Returns whether the file was mapped
+		 */
+		bool open(const std::string &filename);
+
+		/**
+		 * Close
+		 * Unmaps the file, the data must not be used after
+		 */
+		void close();
+
+		/**
+		 * Get Data
+		 * @return Returns the start of the file in memory
+		 */
+		const unsigned char* getData() const { return mData; }
+
+		/**
+		 * Get Size
+		 * @return Returns the size of the file in bytes
+		 */
+		unsigned int getSize() const { return mSize; }
+
+	private:
+		// not copyable, the mapping belongs to one object
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	private:
+		const unsigned char *mData;
+		unsigned int mSize;
+#ifdef _WIN32
+		void *mFile;
+		void *mMapping;
+#else
+		int mFile;
+#endif
+	};
+}
+
+#endif
@@ -0,0 +1,159 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "threadpool.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ST
+{
+	ThreadPool::ThreadPool(unsigned int threads) :
+		mPending(0),
+		mQuit(false)
+	{
+		mMutex = SDL_CreateMutex();
+		mJobReady = SDL_CreateCond();
+		mJobsDone = SDL_CreateCond();
+
+		if (threads == 0)
+			threads = getCoreCount();
+
+		for (unsigned int i = 0; i < threads; ++i)
+		{
+			SDL_Thread *thread = SDL_CreateThread(worker, this);
+			if (thread)
+				mThreads.push_back(thread);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		SDL_LockMutex(mMutex);
+		mQuit = true;
+		SDL_CondBroadcast(mJobReady);
+		SDL_UnlockMutex(mMutex);
+
+		for (unsigned int i = 0; i < mThreads.size(); ++i)
+		{
+			SDL_WaitThread(mThreads[i], NULL);
+		}
+		mThreads.clear();
+
+		SDL_DestroyCond(mJobsDone);
+		SDL_DestroyCond(mJobReady);
+		SDL_DestroyMutex(mMutex);
+	}
+
+	void ThreadPool::addJob(Job *job)
+	{
+		// no threads could be created, so just do the work now
+		if (mThreads.empty())
+		{
+			job->run();
+			return;
+		}
+
+		SDL_LockMutex(mMutex);
+		mJobs.push_back(job);
+		++mPending;
+		SDL_CondSignal(mJobReady);
+		SDL_UnlockMutex(mMutex);
+	}
+
+	void ThreadPool::wait()
+	{
+		SDL_LockMutex(mMutex);
+		while (mPending > 0)
+		{
+			SDL_CondWait(mJobsDone, mMutex);
+		}
+		SDL_UnlockMutex(mMutex);
+	}
+
+	unsigned int ThreadPool::getCoreCount()
+	{
+		long cores = 1;
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		cores = info.dwNumberOfProcessors;
+#else
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		return cores > 0 ? cores : 1;
+	}
+
+	int ThreadPool::worker(void *data)
+	{
+		ThreadPool *pool = static_cast<ThreadPool*>(data);
+
+		SDL_LockMutex(pool->mMutex);
+		while (1)
+		{
+			while (pool->mJobs.empty() && !pool->mQuit)
+			{
+				SDL_CondWait(pool->mJobReady, pool->mMutex);
+			}
+
+			if (pool->mJobs.empty())
+				break;
+
+			Job *job = pool->mJobs.front();
+			pool->mJobs.pop_front();
+
+			SDL_UnlockMutex(pool->mMutex);
+			job->run();
+			SDL_LockMutex(pool->mMutex);
+
+			--pool->mPending;
+			if (pool->mPending == 0)
+				SDL_CondBroadcast(pool->mJobsDone);
+		}
+		SDL_UnlockMutex(pool->mMutex);
+
+		return 0;
+	}
+}
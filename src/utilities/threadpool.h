@@ -0,0 +1,115 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The ThreadPool class runs jobs on a set of worker threads
+ */
+
+#ifndef ST_THREADPOOL_HEADER
+#define ST_THREADPOOL_HEADER
+
+#include <deque>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+namespace ST
+{
+	/**
+	 * A piece of work for the thread pool
+	 */
+	class Job
+	{
+	public:
+		virtual ~Job() {}
+
+		/**
+		 * Run
+		 * Called from a worker thread, must not use the logger
+		 * or anything else that isnt safe to use from another thread
+		 */
+		virtual void run() = 0;
+	};
+
+	class ThreadPool
+	{
+	public:
+		/**
+		 * Constructor
+		 * @param threads Number of threads to create, 0 for one per core
+		 */
+		ThreadPool(unsigned int threads = 0);
+		~ThreadPool();
+
+		/**
+		 * Add Job
+		 * Queues the job to be run, the pool does not delete it
+		 * @param job The job to run
+		 */
+		void addJob(Job *job);
+
+		/**
+		 * Wait
+		 * Blocks until every job added has finished running
+		 */
+		void wait();
+
+		/**
+		 * Get Core Count
+		 * @return Returns the number of processor cores available
+		 */
+		static unsigned int getCoreCount();
+
+	private:
+		static int worker(void *data);
+
+	private:
+		std::vector<SDL_Thread*> mThreads;
+		std::deque<Job*> mJobs;
+		SDL_mutex *mMutex;
+		SDL_cond *mJobReady;
+		SDL_cond *mJobsDone;
+		unsigned int mPending; // jobs added but not finished
+		bool mQuit;
+	};
+}
+
+#endif
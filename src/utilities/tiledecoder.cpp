@@ -0,0 +1,215 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+#include "tiledecoder.h"
+#include "base64.h"
+#include "gzip.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+namespace ST
+{
+    TileDecoder::TileDecoder() : mStream(NULL), mError(NULL)
+    {
+    }
+
+    TileDecoder::~TileDecoder()
+    {
+        if (mStream)
+        {
+            inflateEnd(mStream);
+            delete mStream;
+        }
+    }
+
+    bool TileDecoder::decode(const char *text, const char *encoding, const char *compression,
+                             unsigned char *out, unsigned int size)
+    {
+        mError = NULL;
+
+        if (encoding && strcmp(encoding, "csv") == 0)
+            return decodeCsv(text, out, size);
+
+        if (!encoding || strcmp(encoding, "base64") != 0)
+        {
+            mError = "Error: Unsupported layer encoding!";
+            return false;
+        }
+
+        if (!compression)
+            return decodeBase64(text, out, size);
+
+        // zlib works out which of the two it is from the header
+        if (strcmp(compression, "gzip") != 0 && strcmp(compression, "zlib") != 0)
+        {
+            mError = "Error: Unsupported layer compression!";
+            return false;
+        }
+
+        return inflateBase64(text, out, size);
+    }
+
+    bool TileDecoder::decodeBase64(const char *text, unsigned char *out, unsigned int size)
+    {
+        unsigned int pos = 0;
+        while (pos < size)
+        {
+            int length = Base64::decodePart(text, mBuffer, BUFFER_SIZE);
+            if (length == 0)
+            {
+                mError = "Error: Not enough data for layer!";
+                return false;
+            }
+
+            // anything past the end of the layer is ignored
+            unsigned int copy = std::min<unsigned int>(length, size - pos);
+            memcpy(out + pos, mBuffer, copy);
+            pos += copy;
+        }
+
+        return true;
+    }
+
+    bool TileDecoder::inflateBase64(const char *text, unsigned char *out, unsigned int size)
+    {
+        if (!mStream)
+        {
+            mStream = new z_stream;
+            mStream->zalloc = Z_NULL;
+            mStream->zfree = Z_NULL;
+            mStream->opaque = Z_NULL;
+            mStream->next_in = Z_NULL;
+            mStream->avail_in = 0;
+
+            // add 32 to detect gzip or zlib headers
+            int ret = inflateInit2(mStream, 15 + 32);
+            if (ret != Z_OK)
+            {
+                delete mStream;
+                mStream = NULL;
+                mError = Gzip::getErrorString(ret);
+                return false;
+            }
+        }
+        else
+        {
+            inflateReset(mStream);
+        }
+
+        mStream->next_in = Z_NULL;
+        mStream->avail_in = 0;
+        mStream->next_out = out;
+        mStream->avail_out = size;
+
+        // inflate straight into the layer until its full
+        while (mStream->avail_out > 0)
+        {
+            if (mStream->avail_in == 0)
+            {
+                int length = Base64::decodePart(text, mBuffer, BUFFER_SIZE);
+                if (length == 0)
+                {
+                    mError = "Error: Not enough data for layer!";
+                    return false;
+                }
+
+                mStream->next_in = mBuffer;
+                mStream->avail_in = length;
+            }
+
+            int ret = inflate(mStream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END)
+            {
+                if (mStream->avail_out > 0)
+                {
+                    mError = "Error: Not enough data for layer!";
+                    return false;
+                }
+                break;
+            }
+
+            if (ret == Z_NEED_DICT)
+                ret = Z_DATA_ERROR;
+
+            // buf error only means it needs more input
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                mError = Gzip::getErrorString(ret);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool TileDecoder::decodeCsv(const char *text, unsigned char *out, unsigned int size)
+    {
+        unsigned int pos = 0;
+        while (*text && pos + 4 <= size)
+        {
+            // skip the commas and new lines between ids
+            if (*text < '0' || *text > '9')
+            {
+                ++text;
+                continue;
+            }
+
+            char *end = NULL;
+            unsigned long id = strtoul(text, &end, 10);
+            text = end;
+
+            out[pos] = id & 0xFF;
+            out[pos + 1] = (id >> 8) & 0xFF;
+            out[pos + 2] = (id >> 16) & 0xFF;
+            out[pos + 3] = (id >> 24) & 0xFF;
+            pos += 4;
+        }
+
+        if (pos < size)
+        {
+            mError = "Error: Not enough data for layer!";
+            return false;
+        }
+
+        return true;
+    }
+}
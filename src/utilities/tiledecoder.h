@@ -0,0 +1,96 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * The TileDecoder class turns the data of a TMX layer into tile ids
+ */
+
+#ifndef ST_TILEDECODER_HEADER
+#define ST_TILEDECODER_HEADER
+
+struct z_stream_s;
+
+namespace ST
+{
+	class TileDecoder
+	{
+    public:
+        TileDecoder();
+        ~TileDecoder();
+
+        /**
+         * Decode
+         * Decodes the text of a layer's data element straight into out,
+         * 4 bytes per tile in little endian order. Compressed data is
+         * base64 decoded a piece at a time and inflated as it goes
+         * @param text The text inside the data element
+         * @param encoding The encoding attribute, "base64" or "csv"
+         * @param compression The compression attribute, NULL, "gzip" or "zlib"
+         * @param out Where to put the tile ids
+         * @param size The size of out, every byte must be filled
+         * @return Returns true if the layer was decoded
+         */
+        bool decode(const char *text, const char *encoding, const char *compression,
+                    unsigned char *out, unsigned int size);
+
+        /**
+         * Get Error
+         * Returns the message to log after decode fails
+         */
+        const char* getError() const { return mError; }
+
+    private:
+        // not copyable, the stream belongs to one decoder
+        TileDecoder(const TileDecoder&);
+        TileDecoder& operator=(const TileDecoder&);
+
+        bool decodeBase64(const char *text, unsigned char *out, unsigned int size);
+        bool inflateBase64(const char *text, unsigned char *out, unsigned int size);
+        bool decodeCsv(const char *text, unsigned char *out, unsigned int size);
+
+        // size of the buffer between base64 and inflate, a multiple of 3
+        enum { BUFFER_SIZE = 3 * 2048 };
+
+        z_stream_s *mStream; // created on first use, reset for each layer after
+        const char *mError;
+        unsigned char mBuffer[BUFFER_SIZE];
+	};
+}
+
+#endif
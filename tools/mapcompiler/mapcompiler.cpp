@@ -0,0 +1,288 @@
+/*********************************************
+ *
+ *	Author: David Athay
+ *
+ *	License: New BSD License
+ *
+ *	Copyright (c) 2009, CT Games
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without modification,
+ *	are permitted provided that the following conditions are met:
+ *
+ *	- Redistributions of source code must retain the above copyright notice,
+ *		this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice,
+ *		this list of conditions and the following disclaimer in the documentation
+ *		and/or other materials provided with the distribution.
+ *	- Neither the name of CT Games nor the names of its contributors
+ *		may be used to endorse or promote products derived from this software without
+ *		specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *	IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ *	INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *	BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ *	OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *	OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *	THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *	Date of file creation: 26-10-17
+ *
+ *	$Id$
+ *
+ ********************************************/
+
+/**
+ * Map compiler
+ * Converts a .tmx map into the binary .stmap format read by Map::loadMap,
+ * so the game doesnt need to parse xml or decompress layers at load time.
+ *
+ * Usage: mapcompiler input.tmx [output.stmap]
+ */
+
+#include "mapformat.h"
+
+#include "utilities/log.h"
+#include "utilities/tiledecoder.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <tinyxml.h>
+
+namespace ST
+{
+	// gzip logs its errors
+	Log *logger = NULL;
+}
+
+using namespace ST;
+
+typedef std::vector<unsigned char> Buffer;
+
+static void writeInt(Buffer &out, unsigned int value)
+{
+	out.push_back(value & 0xFF);
+	out.push_back((value >> 8) & 0xFF);
+	out.push_back((value >> 16) & 0xFF);
+	out.push_back((value >> 24) & 0xFF);
+}
+
+static void writeString(Buffer &out, const std::string &str)
+{
+	writeInt(out, str.size());
+	out.insert(out.end(), str.begin(), str.end());
+	out.resize(out.size() + paddedMapLength(str.size()) - str.size(), 0);
+}
+
+static bool readSource(const std::string &filename, unsigned int &size, unsigned int &modified,
+					   unsigned int &checksum)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return false;
+	modified = info.st_mtime;
+
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	Buffer data;
+	unsigned char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	fclose(file);
+
+	size = data.size();
+	checksum = data.empty() ? 0 : mapSourceChecksum(&data[0], size);
+	return true;
+}
+
+static bool readInt(TiXmlElement *e, const char *name, int &value)
+{
+	if (e->QueryIntAttribute(name, &value) != TIXML_SUCCESS)
+	{
+		fprintf(stderr, "Missing attribute %s in <%s>\n", name, e->Value());
+		return false;
+	}
+	return true;
+}
+
+static bool compileTileset(TiXmlElement *e, int tileWidth, int tileHeight, Buffer &out)
+{
+	int id = 0;
+	if (!readInt(e, "firstgid", id))
+		return false;
+
+	int width = tileWidth;
+	int height = tileHeight;
+	e->QueryIntAttribute("tilewidth", &width);
+	e->QueryIntAttribute("tileheight", &height);
+
+	TiXmlElement *image = e->FirstChildElement("image");
+	const char *source = image ? image->Attribute("source") : NULL;
+	if (!source || !*source)
+	{
+		fprintf(stderr, "No source for tileset image\n");
+		return false;
+	}
+
+	writeInt(out, id);
+	writeInt(out, width);
+	writeInt(out, height);
+	writeString(out, source);
+
+	return true;
+}
+
+static bool compileLayer(TiXmlElement *e, TileDecoder &decoder, Buffer &out)
+{
+	int width = 0;
+	int height = 0;
+	if (!readInt(e, "width", width) || !readInt(e, "height", height))
+		return false;
+
+	const char *name = e->Attribute("name");
+	std::string layerName = name ? name : "";
+
+	writeString(out, layerName);
+	writeInt(out, width);
+	writeInt(out, height);
+
+	// characters are added to this layer when playing, it has no tiles
+	if (layerName == "Character")
+	{
+		writeInt(out, 0);
+		return true;
+	}
+
+	TiXmlElement *dataElement = e->FirstChildElement("data");
+	const char *data = dataElement ? dataElement->GetText() : NULL;
+	if (!data)
+	{
+		fprintf(stderr, "No data for layer %s\n", layerName.c_str());
+		return false;
+	}
+
+	// decode straight into the output
+	unsigned int size = width * height * 4;
+	writeInt(out, size);
+	out.resize(out.size() + size);
+
+	if (!decoder.decode(data, dataElement->Attribute("encoding"), dataElement->Attribute("compression"),
+						&out[out.size() - size], size))
+	{
+		fprintf(stderr, "Unable to decode data for layer %s: %s\n", layerName.c_str(), decoder.getError());
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s input.tmx [output.stmap]\n", argv[0]);
+		return 1;
+	}
+
+	std::string input = argv[1];
+	std::string output;
+	if (argc > 2)
+		output = argv[2];
+	else
+		output = input.substr(0, input.rfind('.')) + ".stmap";
+
+	// the game checks these to ignore the compiled map once the .tmx changes
+	unsigned int sourceSize = 0;
+	unsigned int sourceTime = 0;
+	unsigned int sourceChecksum = 0;
+	TiXmlDocument doc(input.c_str());
+	if (!readSource(input, sourceSize, sourceTime, sourceChecksum) || !doc.LoadFile())
+	{
+		fprintf(stderr, "Error loading map %s\n", input.c_str());
+		return 1;
+	}
+
+	TiXmlElement *map = doc.FirstChildElement("map");
+	if (!map)
+	{
+		fprintf(stderr, "Invalid map format\n");
+		return 1;
+	}
+
+	int width, height, tileWidth, tileHeight;
+	if (!readInt(map, "width", width) || !readInt(map, "height", height) ||
+		!readInt(map, "tilewidth", tileWidth) || !readInt(map, "tileheight", tileHeight))
+	{
+		return 1;
+	}
+
+	Buffer tilesets;
+	unsigned int numTilesets = 0;
+	for (TiXmlElement *e = map->FirstChildElement("tileset"); e; e = e->NextSiblingElement("tileset"))
+	{
+		if (!compileTileset(e, tileWidth, tileHeight, tilesets))
+			return 1;
+		++numTilesets;
+	}
+
+	Buffer layers;
+	unsigned int numLayers = 0;
+	TileDecoder decoder;
+	for (TiXmlElement *e = map->FirstChildElement("layer"); e; e = e->NextSiblingElement("layer"))
+	{
+		if (!compileLayer(e, decoder, layers))
+			return 1;
+		++numLayers;
+	}
+
+	if (numTilesets == 0 || numLayers == 0)
+	{
+		fprintf(stderr, "Map needs at least one tileset and layer\n");
+		return 1;
+	}
+
+	Buffer out;
+	writeInt(out, STMAP_MAGIC);
+	writeInt(out, STMAP_VERSION);
+	writeInt(out, width);
+	writeInt(out, height);
+	writeInt(out, tileWidth);
+	writeInt(out, tileHeight);
+	writeInt(out, numTilesets);
+	writeInt(out, numLayers);
+	writeInt(out, sourceSize);
+	writeInt(out, sourceTime);
+	writeInt(out, sourceChecksum);
+	out.insert(out.end(), tilesets.begin(), tilesets.end());
+	out.insert(out.end(), layers.begin(), layers.end());
+
+	FILE *file = fopen(output.c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to write %s\n", output.c_str());
+		return 1;
+	}
+
+	size_t written = fwrite(&out[0], 1, out.size(), file);
+	fclose(file);
+
+	if (written != out.size())
+	{
+		fprintf(stderr, "Unable to write %s\n", output.c_str());
+		return 1;
+	}
+
+	printf("Compiled %s: %d tilesets, %d layers\n", output.c_str(), numTilesets, numLayers);
+
+	return 0;
+}